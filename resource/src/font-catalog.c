@@ -0,0 +1,302 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-catalog.h"
+
+#include <errno.h>
+#include <fontconfig/fontconfig.h>
+#include <glib/gstdio.h>
+#include <locale.h>
+#include <string.h>
+
+/* The catalog caches the list of installed fonts between runs, so the
+ * overview can be filled without asking fontconfig to enumerate them.
+ *
+ * The file is a header, an array of fixed-size entries and a block of
+ * nul-terminated strings the entries point into. Entries are in the
+ * order they were added, which the model keeps sorted by collation
+ * key. It is written in host byte order, since it never leaves the
+ * machine, and mapped as-is.
+ */
+
+#define CATALOG_MAGIC "SMTCATLG"
+#define CATALOG_VERSION 3
+#define CATALOG_FILE "catalog.bin"
+#define STAMP_LENGTH 32
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 n_entries;
+    gchar stamp[STAMP_LENGTH];
+} CatalogHeader;
+
+typedef struct {
+    guint32 path;
+    guint32 font_name;
+    guint32 collation_key;
+    gint32 face_index;
+} CatalogEntry;
+
+struct _FontCatalog {
+    GMappedFile *mapped_file;
+    const CatalogEntry *entries;
+    guint n_entries;
+    const gchar *strings;
+};
+
+struct _FontCatalogWriter {
+    GArray *entries;
+    GString *strings;
+};
+
+static gchar *
+get_catalog_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "showmytext",
+                             CATALOG_FILE, NULL);
+}
+
+static void
+stamp_add_files (GChecksum *checksum,
+                 FcStrList *list)
+{
+    FcChar8 *path;
+
+    if (list == NULL)
+        return;
+
+    while ((path = FcStrListNext (list)) != NULL) {
+        GStatBuf st;
+        g_autofree gchar *entry = NULL;
+
+        if (g_stat ((const gchar *) path, &st) == 0)
+            entry = g_strdup_printf ("%s:%" G_GINT64_FORMAT ":%" G_GUINT64_FORMAT ";",
+                                     path, (gint64) st.st_mtime, (guint64) st.st_ino);
+        else
+            entry = g_strdup_printf ("%s:-;", path);
+
+        g_checksum_update (checksum, (const guchar *) entry, -1);
+    }
+
+    FcStrListDone (list);
+}
+
+/* Returns a digest of everything the catalog depends on: the fontconfig
+ * configuration files, the font directories and the fontconfig cache
+ * directories, with their modification times, plus the collation
+ * locale the keys were computed in. Any font installed or removed
+ * through fontconfig touches one of these.
+ */
+gchar *
+font_catalog_compute_stamp (void)
+{
+    FcConfig *config = FcConfigGetCurrent ();
+    g_autoptr(GChecksum) checksum = g_checksum_new (G_CHECKSUM_MD5);
+    g_autofree gchar *header = NULL;
+
+    header = g_strdup_printf ("%d:%d:%s;", CATALOG_VERSION, FcGetVersion (),
+                              setlocale (LC_COLLATE, NULL));
+    g_checksum_update (checksum, (const guchar *) header, -1);
+
+    stamp_add_files (checksum, FcConfigGetConfigFiles (config));
+    stamp_add_files (checksum, FcConfigGetFontDirs (config));
+    stamp_add_files (checksum, FcConfigGetCacheDirs (config));
+
+    return g_strdup (g_checksum_get_string (checksum));
+}
+
+/* Maps the catalog if there is one that matches @stamp. Returns NULL
+ * when it is missing, stale or damaged; the caller then enumerates the
+ * fonts and writes a new one.
+ */
+FontCatalog *
+font_catalog_open (const gchar *stamp)
+{
+    g_autofree gchar *path = get_catalog_path ();
+    g_autoptr(GMappedFile) mapped_file = NULL;
+    const CatalogHeader *header;
+    const gchar *contents;
+    gsize length, strings_length;
+    FontCatalog *self;
+    guint idx;
+
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    if (mapped_file == NULL)
+        return NULL;
+
+    contents = g_mapped_file_get_contents (mapped_file);
+    length = g_mapped_file_get_length (mapped_file);
+
+    if (length < sizeof (CatalogHeader))
+        return NULL;
+
+    header = (const CatalogHeader *) contents;
+    if (memcmp (header->magic, CATALOG_MAGIC, sizeof (header->magic)) != 0 ||
+        header->version != CATALOG_VERSION ||
+        strncmp (header->stamp, stamp, STAMP_LENGTH) != 0)
+        return NULL;
+
+    if (header->n_entries > (length - sizeof (CatalogHeader)) / sizeof (CatalogEntry))
+        return NULL;
+
+    self = g_slice_new0 (FontCatalog);
+    self->entries = (const CatalogEntry *) (contents + sizeof (CatalogHeader));
+    self->n_entries = header->n_entries;
+    self->strings = (const gchar *) (self->entries + self->n_entries);
+    strings_length = contents + length - self->strings;
+    self->mapped_file = g_steal_pointer (&mapped_file);
+
+    /* Every string offset must land inside the string block, and the
+     * block must end with a nul so no string can run past it. */
+    if (strings_length == 0 || self->strings[strings_length - 1] != '\0')
+        goto damaged;
+
+    for (idx = 0; idx < self->n_entries; idx++) {
+        const CatalogEntry *entry = &self->entries[idx];
+
+        if (entry->path >= strings_length ||
+            entry->font_name >= strings_length ||
+            entry->collation_key >= strings_length)
+            goto damaged;
+    }
+
+    return self;
+
+ damaged:
+    font_catalog_free (self);
+    return NULL;
+}
+
+void
+font_catalog_free (FontCatalog *self)
+{
+    g_mapped_file_unref (self->mapped_file);
+    g_slice_free (FontCatalog, self);
+}
+
+guint
+font_catalog_get_n_entries (FontCatalog *self)
+{
+    return self->n_entries;
+}
+
+const gchar *
+font_catalog_get_path (FontCatalog *self,
+                       guint index)
+{
+    return self->strings + self->entries[index].path;
+}
+
+const gchar *
+font_catalog_get_font_name (FontCatalog *self,
+                            guint index)
+{
+    return self->strings + self->entries[index].font_name;
+}
+
+const gchar *
+font_catalog_get_collation_key (FontCatalog *self,
+                                guint index)
+{
+    return self->strings + self->entries[index].collation_key;
+}
+
+gint
+font_catalog_get_face_index (FontCatalog *self,
+                             guint index)
+{
+    return self->entries[index].face_index;
+}
+
+FontCatalogWriter *
+font_catalog_writer_new (void)
+{
+    FontCatalogWriter *self = g_slice_new0 (FontCatalogWriter);
+
+    self->entries = g_array_new (FALSE, FALSE, sizeof (CatalogEntry));
+    self->strings = g_string_new (NULL);
+
+    return self;
+}
+
+void
+font_catalog_writer_free (FontCatalogWriter *self)
+{
+    g_array_unref (self->entries);
+    g_string_free (self->strings, TRUE);
+    g_slice_free (FontCatalogWriter, self);
+}
+
+static guint32
+writer_add_string (FontCatalogWriter *self,
+                   const gchar *str)
+{
+    guint32 offset = self->strings->len;
+
+    g_string_append_len (self->strings, str, strlen (str) + 1);
+
+    return offset;
+}
+
+void
+font_catalog_writer_add (FontCatalogWriter *self,
+                         const gchar *path,
+                         gint face_index,
+                         const gchar *font_name,
+                         const gchar *collation_key)
+{
+    CatalogEntry entry;
+
+    entry.path = writer_add_string (self, path);
+    entry.font_name = writer_add_string (self, font_name);
+    entry.collation_key = writer_add_string (self, collation_key);
+    entry.face_index = face_index;
+
+    g_array_append_val (self->entries, entry);
+}
+
+/* Replaces the catalog on disk atomically, so a concurrent reader keeps
+ * seeing the old file until it maps again.
+ */
+gboolean
+font_catalog_writer_save (FontCatalogWriter *self,
+                          const gchar *stamp,
+                          GError **error)
+{
+    g_autofree gchar *path = get_catalog_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    CatalogHeader header = { { 0, } };
+
+    if (g_mkdir_with_parents (dir, 0755) != 0) {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to create %s", dir);
+        return FALSE;
+    }
+
+    memcpy (header.magic, CATALOG_MAGIC, sizeof (header.magic));
+    header.version = CATALOG_VERSION;
+    header.n_entries = self->entries->len;
+    strncpy (header.stamp, stamp, STAMP_LENGTH);
+
+    g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+    g_byte_array_append (data, (const guint8 *) self->entries->data,
+                         self->entries->len * sizeof (CatalogEntry));
+    g_byte_array_append (data, (const guint8 *) self->strings->str,
+                         self->strings->len);
+
+    return g_file_set_contents (path, (const gchar *) data->data, data->len, error);
+}
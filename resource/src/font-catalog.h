@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_CATALOG_H__
+#define __FONT_CATALOG_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FontCatalog FontCatalog;
+typedef struct _FontCatalogWriter FontCatalogWriter;
+
+gchar *font_catalog_compute_stamp (void);
+
+FontCatalog *font_catalog_open (const gchar *stamp);
+void font_catalog_free (FontCatalog *self);
+
+guint font_catalog_get_n_entries (FontCatalog *self);
+const gchar *font_catalog_get_path (FontCatalog *self,
+                                    guint index);
+const gchar *font_catalog_get_font_name (FontCatalog *self,
+                                         guint index);
+const gchar *font_catalog_get_collation_key (FontCatalog *self,
+                                             guint index);
+gint font_catalog_get_face_index (FontCatalog *self,
+                                  guint index);
+
+FontCatalogWriter *font_catalog_writer_new (void);
+void font_catalog_writer_free (FontCatalogWriter *self);
+
+void font_catalog_writer_add (FontCatalogWriter *self,
+                              const gchar *path,
+                              gint face_index,
+                              const gchar *font_name,
+                              const gchar *collation_key);
+gboolean font_catalog_writer_save (FontCatalogWriter *self,
+                                   const gchar *stamp,
+                                   GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontCatalog, font_catalog_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontCatalogWriter, font_catalog_writer_free)
+
+G_END_DECLS
+
+#endif /* __FONT_CATALOG_H__ */
@@ -0,0 +1,502 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-coverage.h"
+
+#include <errno.h>
+#include <fontconfig/fontconfig.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "font-store.h"
+
+/* The codepoints each installed face maps, so the overview can be
+ * narrowed to the fonts that render a text without opening any.
+ *
+ * Coverage is kept the way fontconfig keeps it: the 256-codepoint
+ * pages a face has glyphs in, in ascending order, each with a bitmap
+ * of the codepoints it maps. A typical face spans a few dozen pages,
+ * and testing a text is a walk over its pages and the face's side by
+ * side.
+ *
+ * The result is cached on disk between runs, keyed by path, face index
+ * and the modification time of the file. The file is a header, the
+ * entries, the pages they point into and a block of nul-terminated
+ * strings, in host byte order like the catalog.
+ */
+
+#define COVERAGE_MAGIC "SMTCOVRG"
+#define COVERAGE_VERSION 1
+#define COVERAGE_FILE "coverage.bin"
+#define PAGE_WORDS (256 / 32)
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 n_entries;
+    guint32 n_pages;
+    guint32 strings_length;
+} CoverageHeader;
+
+typedef struct {
+    guint32 path;
+    gint32 face_index;
+    gint64 mtime;
+    guint32 first_page;
+    guint32 n_pages;
+} CoverageEntry;
+
+typedef struct {
+    /* The first codepoint of the page, shifted right by eight. */
+    guint32 page;
+    guint32 bits[PAGE_WORDS];
+} CoveragePage;
+
+struct _FontCoverage {
+    GArray *entries;
+    GArray *pages;
+    GString *strings;
+    /* Entry index + 1 of each face it was built for, in the order they
+     * were given, or 0 for a face without known coverage. */
+    guint32 *face_entries;
+    guint n_faces;
+};
+
+struct _FontCoverageQuery {
+    GArray *pages;
+};
+
+/* The cache file of a previous run, mapped. */
+typedef struct {
+    GMappedFile *mapped_file;
+    const CoverageEntry *entries;
+    guint n_entries;
+    const CoveragePage *pages;
+    const gchar *strings;
+    GHashTable *entries_by_key;
+} CoverageCache;
+
+static gchar *
+get_coverage_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "showmytext",
+                             COVERAGE_FILE, NULL);
+}
+
+static gchar *
+make_face_key (const gchar *path,
+               gint face_index)
+{
+    return g_strdup_printf ("%s:%d", path, face_index);
+}
+
+static void
+coverage_cache_free (CoverageCache *cache)
+{
+    g_clear_pointer (&cache->entries_by_key, g_hash_table_unref);
+    g_mapped_file_unref (cache->mapped_file);
+    g_slice_free (CoverageCache, cache);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CoverageCache, coverage_cache_free)
+
+/* Returns NULL when there is no cache, or it is from another version or
+ * damaged; everything is then computed again. */
+static CoverageCache *
+coverage_cache_open (void)
+{
+    g_autofree gchar *path = get_coverage_path ();
+    g_autoptr(GMappedFile) mapped_file = NULL;
+    g_autoptr(CoverageCache) cache = NULL;
+    const CoverageHeader *header;
+    const gchar *contents;
+    gsize length;
+    guint idx;
+
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    if (mapped_file == NULL)
+        return NULL;
+
+    contents = g_mapped_file_get_contents (mapped_file);
+    length = g_mapped_file_get_length (mapped_file);
+
+    if (length < sizeof (CoverageHeader))
+        return NULL;
+
+    header = (const CoverageHeader *) contents;
+    if (memcmp (header->magic, COVERAGE_MAGIC, sizeof (header->magic)) != 0 ||
+        header->version != COVERAGE_VERSION)
+        return NULL;
+
+    length -= sizeof (CoverageHeader);
+    if (header->n_entries > length / sizeof (CoverageEntry))
+        return NULL;
+
+    length -= header->n_entries * sizeof (CoverageEntry);
+    if (header->n_pages > length / sizeof (CoveragePage))
+        return NULL;
+
+    length -= header->n_pages * sizeof (CoveragePage);
+    if (header->strings_length == 0 || header->strings_length != length)
+        return NULL;
+
+    cache = g_slice_new0 (CoverageCache);
+    cache->entries = (const CoverageEntry *) (contents + sizeof (CoverageHeader));
+    cache->n_entries = header->n_entries;
+    cache->pages = (const CoveragePage *) (cache->entries + cache->n_entries);
+    cache->strings = (const gchar *) (cache->pages + header->n_pages);
+    cache->mapped_file = g_steal_pointer (&mapped_file);
+
+    if (cache->strings[header->strings_length - 1] != '\0')
+        return NULL;
+
+    cache->entries_by_key = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    for (idx = 0; idx < cache->n_entries; idx++) {
+        const CoverageEntry *entry = &cache->entries[idx];
+
+        if (entry->path >= header->strings_length ||
+            (guint64) entry->first_page + entry->n_pages > header->n_pages)
+            return NULL;
+
+        g_hash_table_insert (cache->entries_by_key,
+                             make_face_key (cache->strings + entry->path, entry->face_index),
+                             (gpointer) entry);
+    }
+
+    return g_steal_pointer (&cache);
+}
+
+static FontCoverage *
+font_coverage_new (guint n_faces)
+{
+    FontCoverage *self = g_slice_new0 (FontCoverage);
+
+    self->entries = g_array_new (FALSE, FALSE, sizeof (CoverageEntry));
+    self->pages = g_array_new (FALSE, FALSE, sizeof (CoveragePage));
+    self->strings = g_string_new (NULL);
+    self->face_entries = g_new0 (guint32, n_faces);
+    self->n_faces = n_faces;
+
+    return self;
+}
+
+void
+font_coverage_free (FontCoverage *self)
+{
+    g_array_unref (self->entries);
+    g_array_unref (self->pages);
+    g_string_free (self->strings, TRUE);
+    g_free (self->face_entries);
+    g_slice_free (FontCoverage, self);
+}
+
+/* Records face @face, whose pages were appended from @first_page on. */
+static void
+font_coverage_add_entry (FontCoverage *self,
+                         guint face,
+                         const gchar *path,
+                         gint face_index,
+                         gint64 mtime,
+                         guint first_page)
+{
+    CoverageEntry entry;
+
+    entry.path = self->strings->len;
+    entry.face_index = face_index;
+    entry.mtime = mtime;
+    entry.first_page = first_page;
+    entry.n_pages = self->pages->len - first_page;
+
+    g_string_append_len (self->strings, path, strlen (path) + 1);
+    g_array_append_val (self->entries, entry);
+    self->face_entries[face] = self->entries->len;
+}
+
+static void
+append_charset_pages (GArray *pages,
+                      const FcCharSet *charset)
+{
+    FcChar32 map[FC_CHARSET_MAP_SIZE];
+    FcChar32 base, next;
+
+    for (base = FcCharSetFirstPage (charset, map, &next);
+         base != FC_CHARSET_DONE;
+         base = FcCharSetNextPage (charset, map, &next)) {
+        CoveragePage page;
+
+        page.page = base >> 8;
+        memcpy (page.bits, map, sizeof (page.bits));
+        g_array_append_val (pages, page);
+    }
+}
+
+/* Fontconfig has the coverage of every face it knows in its own cache,
+ * so listing it is much cheaper than opening the fonts. The charsets in
+ * @charsets belong to the returned font set, and are keyed by canonical
+ * path like the store. */
+static FcFontSet *
+list_charsets (GHashTable *charsets)
+{
+    FcPattern *pat;
+    FcObjectSet *os;
+    FcFontSet *font_list;
+    gint i;
+
+    pat = FcPatternCreate ();
+    os = FcObjectSetBuild (FC_FILE, FC_INDEX, FC_CHARSET, NULL);
+
+    FcPatternAddBool (pat, FC_SCALABLE, FcTrue);
+    font_list = FcFontList (NULL, pat, os);
+
+    FcPatternDestroy (pat);
+    FcObjectSetDestroy (os);
+
+    if (font_list == NULL)
+        return NULL;
+
+    for (i = 0; i < font_list->nfont; i++) {
+        g_autofree gchar *canonical = NULL;
+        FcChar8 *path;
+        FcCharSet *charset;
+        int index;
+
+        if (FcPatternGetString (font_list->fonts[i], FC_FILE, 0, &path) != FcResultMatch ||
+            FcPatternGetCharSet (font_list->fonts[i], FC_CHARSET, 0, &charset) != FcResultMatch)
+            continue;
+        if (FcPatternGetInteger (font_list->fonts[i], FC_INDEX, 0, &index) != FcResultMatch)
+            index = 0;
+
+        canonical = font_store_canonicalize_path ((const gchar *) path);
+        g_hash_table_insert (charsets, make_face_key (canonical, index), charset);
+    }
+
+    return font_list;
+}
+
+static gboolean
+font_coverage_save (FontCoverage *self,
+                    GError **error)
+{
+    g_autofree gchar *path = get_coverage_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    CoverageHeader header = { { 0, } };
+
+    if (g_mkdir_with_parents (dir, 0755) != 0) {
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+                     "Unable to create %s", dir);
+        return FALSE;
+    }
+
+    /* An empty string block would read as damaged. */
+    if (self->strings->len == 0)
+        g_string_append_c (self->strings, '\0');
+
+    memcpy (header.magic, COVERAGE_MAGIC, sizeof (header.magic));
+    header.version = COVERAGE_VERSION;
+    header.n_entries = self->entries->len;
+    header.n_pages = self->pages->len;
+    header.strings_length = self->strings->len;
+
+    g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+    g_byte_array_append (data, (const guint8 *) self->entries->data,
+                         self->entries->len * sizeof (CoverageEntry));
+    g_byte_array_append (data, (const guint8 *) self->pages->data,
+                         self->pages->len * sizeof (CoveragePage));
+    g_byte_array_append (data, (const guint8 *) self->strings->str,
+                         self->strings->len);
+
+    return g_file_set_contents (path, (const gchar *) data->data, data->len, error);
+}
+
+/* Computes the coverage of the given faces, reusing the cache for the
+ * files that haven't changed since it was written, and writes the cache
+ * again if anything differs. Blocks; meant for a worker thread. Returns
+ * NULL if @cancellable is cancelled.
+ */
+FontCoverage *
+font_coverage_build (const gchar * const *paths,
+                     const gint *face_indexes,
+                     guint n_faces,
+                     GCancellable *cancellable)
+{
+    g_autoptr(FontCoverage) self = font_coverage_new (n_faces);
+    g_autoptr(CoverageCache) cache = coverage_cache_open ();
+    g_autoptr(GArray) missing = g_array_new (FALSE, FALSE, sizeof (guint));
+    g_autofree gint64 *mtimes = g_new0 (gint64, n_faces);
+    g_autoptr(GError) error = NULL;
+    guint idx;
+
+    for (idx = 0; idx < n_faces; idx++) {
+        const CoverageEntry *cached = NULL;
+        GStatBuf st;
+
+        if (g_cancellable_is_cancelled (cancellable))
+            return NULL;
+
+        /* Gone since it was listed; the next reload drops it. */
+        if (g_stat (paths[idx], &st) != 0)
+            continue;
+
+        mtimes[idx] = st.st_mtime;
+
+        if (cache != NULL) {
+            g_autofree gchar *key = make_face_key (paths[idx], face_indexes[idx]);
+            cached = g_hash_table_lookup (cache->entries_by_key, key);
+        }
+
+        if (cached != NULL && cached->mtime == mtimes[idx]) {
+            guint first_page = self->pages->len;
+
+            g_array_append_vals (self->pages, cache->pages + cached->first_page,
+                                 cached->n_pages);
+            font_coverage_add_entry (self, idx, paths[idx], face_indexes[idx],
+                                     mtimes[idx], first_page);
+        } else {
+            g_array_append_val (missing, idx);
+        }
+    }
+
+    if (missing->len > 0) {
+        g_autoptr(GHashTable) charsets = NULL;
+        FcFontSet *font_list;
+
+        charsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+        font_list = list_charsets (charsets);
+
+        for (idx = 0; idx < missing->len && font_list != NULL; idx++) {
+            guint face = g_array_index (missing, guint, idx);
+            g_autofree gchar *key = make_face_key (paths[face], face_indexes[face]);
+            FcCharSet *charset = g_hash_table_lookup (charsets, key);
+            guint first_page = self->pages->len;
+
+            if (charset == NULL)
+                continue;
+
+            append_charset_pages (self->pages, charset);
+            font_coverage_add_entry (self, face, paths[face], face_indexes[face],
+                                     mtimes[face], first_page);
+        }
+
+        g_clear_pointer (&charsets, g_hash_table_unref);
+        if (font_list != NULL)
+            FcFontSetDestroy (font_list);
+    }
+
+    if (g_cancellable_is_cancelled (cancellable))
+        return NULL;
+
+    if ((missing->len > 0 || cache == NULL || cache->n_entries != self->entries->len) &&
+        !font_coverage_save (self, &error))
+        g_warning ("Can't save the font coverage: %s", error->message);
+
+    return g_steal_pointer (&self);
+}
+
+/* An empty query, that every face covers; texts are added to it with
+ * font_coverage_query_add_text(). */
+FontCoverageQuery *
+font_coverage_query_new (void)
+{
+    FontCoverageQuery *query = g_slice_new0 (FontCoverageQuery);
+
+    query->pages = g_array_new (FALSE, TRUE, sizeof (CoveragePage));
+
+    return query;
+}
+
+/* Adds the codepoints of the @length bytes of @text that a font has to
+ * map to render it. Spaces, controls and format characters such as
+ * joiners are left out: layout deals with those without the font's
+ * help. */
+void
+font_coverage_query_add_text (FontCoverageQuery *query,
+                              const gchar *text,
+                              gsize length)
+{
+    const gchar *p, *end = text + length;
+
+    for (p = text; p < end; p = g_utf8_next_char (p)) {
+        gunichar ch = g_utf8_get_char (p);
+        GUnicodeType type = g_unichar_type (ch);
+        CoveragePage *page;
+        guint idx;
+
+        if (g_unichar_isspace (ch) || type == G_UNICODE_CONTROL || type == G_UNICODE_FORMAT)
+            continue;
+
+        /* Texts span few pages; keep them sorted by insertion. */
+        for (idx = 0; idx < query->pages->len; idx++) {
+            if (g_array_index (query->pages, CoveragePage, idx).page >= ch >> 8)
+                break;
+        }
+
+        if (idx == query->pages->len ||
+            g_array_index (query->pages, CoveragePage, idx).page != ch >> 8) {
+            CoveragePage new_page = { ch >> 8, { 0, } };
+            g_array_insert_val (query->pages, idx, new_page);
+        }
+
+        page = &g_array_index (query->pages, CoveragePage, idx);
+        page->bits[(ch & 0xff) >> 5] |= 1u << (ch & 0x1f);
+    }
+}
+
+void
+font_coverage_query_free (FontCoverageQuery *query)
+{
+    g_array_unref (query->pages);
+    g_slice_free (FontCoverageQuery, query);
+}
+
+/* Whether @face, a position in the arrays @self was built from, maps
+ * every codepoint of @query. Faces without known coverage never do. */
+gboolean
+font_coverage_covers (FontCoverage *self,
+                      guint face,
+                      const FontCoverageQuery *query)
+{
+    const CoverageEntry *entry;
+    const CoveragePage *pages;
+    guint entry_idx, idx, n = 0;
+
+    g_return_val_if_fail (face < self->n_faces, FALSE);
+
+    entry_idx = self->face_entries[face];
+    if (entry_idx == 0)
+        return FALSE;
+
+    entry = &g_array_index (self->entries, CoverageEntry, entry_idx - 1);
+    pages = (const CoveragePage *) self->pages->data + entry->first_page;
+
+    for (idx = 0; idx < query->pages->len; idx++) {
+        const CoveragePage *wanted = &g_array_index (query->pages, CoveragePage, idx);
+        guint word;
+
+        while (n < entry->n_pages && pages[n].page < wanted->page)
+            n++;
+
+        if (n == entry->n_pages || pages[n].page != wanted->page)
+            return FALSE;
+
+        for (word = 0; word < PAGE_WORDS; word++) {
+            if ((pages[n].bits[word] & wanted->bits[word]) != wanted->bits[word])
+                return FALSE;
+        }
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,47 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_COVERAGE_H__
+#define __FONT_COVERAGE_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FontCoverage FontCoverage;
+typedef struct _FontCoverageQuery FontCoverageQuery;
+
+FontCoverage *font_coverage_build (const gchar * const *paths,
+                                   const gint *face_indexes,
+                                   guint n_faces,
+                                   GCancellable *cancellable);
+void font_coverage_free (FontCoverage *self);
+
+FontCoverageQuery *font_coverage_query_new (void);
+void font_coverage_query_add_text (FontCoverageQuery *query,
+                                   const gchar *text,
+                                   gsize length);
+void font_coverage_query_free (FontCoverageQuery *query);
+
+gboolean font_coverage_covers (FontCoverage *self,
+                               guint face,
+                               const FontCoverageQuery *query);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontCoverage, font_coverage_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontCoverageQuery, font_coverage_query_free)
+
+G_END_DECLS
+
+#endif /* __FONT_COVERAGE_H__ */
@@ -0,0 +1,867 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "font-info.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib/gi18n.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_TYPE1_TABLES_H
+#include FT_SFNT_NAMES_H
+#include FT_TRUETYPE_IDS_H
+#include FT_MULTIPLE_MASTERS_H
+#include <hb.h>
+#include <hb-ot.h>
+#include <hb-ft.h>
+
+#include "open-type-layout.h"
+#include "sushi-font-loader.h"
+
+/* The details shown on the Info page, read off the main thread.
+ *
+ * A worker opens the face with its own FreeType library and turns
+ * everything the page shows into rows of translated labels and values,
+ * so the main thread only has to build labels from them. Finished
+ * records are kept by location, face index and modification time,
+ * most recently used first, so going back to a font shows its details
+ * without opening it again.
+ */
+
+#define MAX_CACHED_INFOS 64
+
+typedef struct {
+    /* Translated, static. */
+    const gchar *label;
+    gchar *value;
+    gboolean multiline;
+} FontInfoRow;
+
+struct _FontInfo {
+    gint ref_count;
+    GArray *rows;
+};
+
+typedef struct {
+    GFile *file;
+    gint face_index;
+} FontInfoJob;
+
+/* "uri:index:mtime" -> FontInfo, and the keys, most recently used
+ * first. Looked up by the workers, since the key needs the file's
+ * modification time. */
+static GHashTable *info_cache = NULL;
+static GQueue info_cache_lru = G_QUEUE_INIT;
+G_LOCK_DEFINE_STATIC (info_cache);
+
+static void
+font_info_row_clear (gpointer data)
+{
+    FontInfoRow *row = data;
+
+    g_free (row->value);
+}
+
+static FontInfo *
+font_info_new (void)
+{
+    FontInfo *self = g_slice_new0 (FontInfo);
+
+    self->ref_count = 1;
+    self->rows = g_array_new (FALSE, FALSE, sizeof (FontInfoRow));
+    g_array_set_clear_func (self->rows, font_info_row_clear);
+
+    return self;
+}
+
+FontInfo *
+font_info_ref (FontInfo *self)
+{
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+font_info_unref (FontInfo *self)
+{
+    if (!g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    g_array_unref (self->rows);
+    g_slice_free (FontInfo, self);
+}
+
+guint
+font_info_get_n_rows (FontInfo *self)
+{
+    return self->rows->len;
+}
+
+/* Returns the label of row @idx, and sets @value and @multiline. */
+const gchar *
+font_info_get_row (FontInfo *self,
+                   guint idx,
+                   const gchar **value,
+                   gboolean *multiline)
+{
+    FontInfoRow *row = &g_array_index (self->rows, FontInfoRow, idx);
+
+    *value = row->value;
+    *multiline = row->multiline;
+
+    return row->label;
+}
+
+static void
+add_row (FontInfo *self,
+         const gchar *label,
+         const gchar *value,
+         gboolean multiline)
+{
+    FontInfoRow row = { label, g_strdup (value), multiline };
+
+    g_array_append_val (self->rows, row);
+}
+
+#define WHITESPACE_CHARS "\f \t"
+
+static void
+strip_whitespace (gchar **original)
+{
+    g_auto(GStrv) split = NULL;
+    g_autoptr(GString) reassembled = NULL;
+    const gchar *str;
+    gint idx, n_stripped;
+    size_t len;
+
+    split = g_strsplit (*original, "\n", -1);
+    reassembled = g_string_new (NULL);
+    n_stripped = 0;
+
+    for (idx = 0; split[idx] != NULL; idx++) {
+        str = split[idx];
+
+        len = strspn (str, WHITESPACE_CHARS);
+        if (len)
+            str += len;
+
+        if (strlen (str) == 0 &&
+            ((split[idx + 1] == NULL) || strlen (split[idx + 1]) == 0))
+            continue;
+
+        if (n_stripped++ > 0)
+            g_string_append (reassembled, "\n");
+        g_string_append (reassembled, str);
+    }
+
+    g_free (*original);
+    *original = g_strdup (reassembled->str);
+}
+
+#define MATCH_VERSION_STR "Version"
+
+static void
+strip_version (gchar **original)
+{
+    gchar *ptr, *stripped;
+
+    ptr = g_strstr_len (*original, -1, MATCH_VERSION_STR);
+    if (!ptr)
+        return;
+
+    ptr += strlen (MATCH_VERSION_STR);
+    stripped = g_strdup (ptr);
+
+    strip_whitespace (&stripped);
+
+    g_free (*original);
+    *original = stripped;
+}
+
+#define FixedToFloat(f) (((float)(f))/65536.0)
+
+static char *
+describe_axis (FT_Var_Axis *ax)
+{
+  return g_strdup_printf (_("%s %g — %g, default %g"), ax->name,
+                          FixedToFloat (ax->minimum),
+                          FixedToFloat (ax->maximum),
+                          FixedToFloat (ax->def));
+}
+
+/* The name table of a face, indexed in one pass: for each name id, the
+ * record in the language and encoding we read best. Records are only
+ * decoded when asked for, and once.
+ */
+typedef struct {
+    FT_Face face;
+    /* Name id -> NameEntry. */
+    GHashTable *entries;
+} NameTable;
+
+typedef struct {
+    guint index;
+    gint rank;
+    gchar *value;
+    gboolean decoded;
+} NameEntry;
+
+static void
+name_entry_free (gpointer data)
+{
+    NameEntry *entry = data;
+
+    g_free (entry->value);
+    g_slice_free (NameEntry, entry);
+}
+
+/* Lower is better; -1 for records we can't decode. US English comes
+ * first, as it is what fonts fill in most completely, then any other
+ * English, then Unicode in any language, then Mac Roman. */
+static gint
+name_record_rank (const FT_SfntName *sname)
+{
+    switch (sname->platform_id) {
+    case TT_PLATFORM_MICROSOFT:
+        if (sname->encoding_id != TT_MS_ID_UNICODE_CS &&
+            sname->encoding_id != TT_MS_ID_UCS_4 &&
+            sname->encoding_id != TT_MS_ID_SYMBOL_CS)
+            return -1;
+        if (sname->language_id == TT_MS_LANGID_ENGLISH_UNITED_STATES)
+            return 0;
+        /* The primary language is in the low ten bits. */
+        if ((sname->language_id & 0x3ff) == (TT_MS_LANGID_ENGLISH_UNITED_STATES & 0x3ff))
+            return 1;
+        return 3;
+    case TT_PLATFORM_APPLE_UNICODE:
+        return 2;
+    case TT_PLATFORM_MACINTOSH:
+        if (sname->encoding_id != TT_MAC_ID_ROMAN)
+            return -1;
+        return sname->language_id == TT_MAC_LANGID_ENGLISH ? 4 : 5;
+    default:
+        return -1;
+    }
+}
+
+static void
+name_table_init (NameTable *self,
+                 FT_Face face)
+{
+    guint i, count;
+
+    self->face = face;
+    self->entries = g_hash_table_new_full (NULL, NULL, NULL, name_entry_free);
+
+    if (!FT_IS_SFNT (face))
+        return;
+
+    count = FT_Get_Sfnt_Name_Count (face);
+    for (i = 0; i < count; i++) {
+        FT_SfntName sname;
+        NameEntry *entry;
+        gint rank;
+
+        if (FT_Get_Sfnt_Name (face, i, &sname) != 0)
+            continue;
+
+        rank = name_record_rank (&sname);
+        if (rank < 0)
+            continue;
+
+        entry = g_hash_table_lookup (self->entries, GUINT_TO_POINTER (sname.name_id));
+        if (entry == NULL) {
+            entry = g_slice_new0 (NameEntry);
+            g_hash_table_insert (self->entries, GUINT_TO_POINTER (sname.name_id), entry);
+        } else if (entry->rank <= rank) {
+            continue;
+        }
+
+        entry->index = i;
+        entry->rank = rank;
+    }
+}
+
+static void
+name_table_clear (NameTable *self)
+{
+    g_clear_pointer (&self->entries, g_hash_table_unref);
+}
+
+/* Returns name @name_id in UTF-8, or NULL. */
+static const gchar *
+name_table_lookup (NameTable *self,
+                   guint name_id)
+{
+    NameEntry *entry;
+    FT_SfntName sname;
+
+    entry = g_hash_table_lookup (self->entries, GUINT_TO_POINTER (name_id));
+    if (entry == NULL)
+        return NULL;
+
+    if (entry->decoded)
+        return entry->value;
+
+    entry->decoded = TRUE;
+
+    if (FT_Get_Sfnt_Name (self->face, entry->index, &sname) != 0)
+        return NULL;
+
+    entry->value = g_convert ((gchar *) sname.string, sname.string_len, "UTF-8",
+                              sname.platform_id == TT_PLATFORM_MACINTOSH ? "MACINTOSH" : "UTF-16BE",
+                              NULL, NULL, NULL);
+
+    return entry->value;
+}
+
+static gboolean
+is_valid_subfamily_id (guint id)
+{
+  return id == 2 || id == 17 || (255 < id && id < 32768);
+}
+
+static void
+describe_instance (NameTable *names,
+                   FT_Var_Named_Style *ns,
+                   int pos,
+                   GString *s)
+{
+    g_autofree char *str = NULL;
+
+    if (is_valid_subfamily_id (ns->strid))
+        str = g_strdup (name_table_lookup (names, ns->strid));
+
+    if (str == NULL)
+        str = g_strdup_printf (_("Instance %d"), pos);
+
+    if (s->len > 0)
+        g_string_append (s, ", ");
+    g_string_append (s, str);
+}
+
+
+/* Tag -> untranslated feature name, from open-type-layout.h. */
+static GHashTable *
+get_feature_names (void)
+{
+    static GHashTable *names = NULL;
+
+    if (g_once_init_enter (&names)) {
+        GHashTable *table = g_hash_table_new (NULL, NULL);
+        guint k;
+
+        for (k = 0; k < G_N_ELEMENTS (open_type_layout_features); k++)
+            g_hash_table_insert (table, GUINT_TO_POINTER (open_type_layout_features[k].tag),
+                                 (gpointer) open_type_layout_features[k].name);
+
+        g_once_init_leave (&names, table);
+    }
+
+    return names;
+}
+
+/* The named features of one script, in the order first seen. */
+typedef struct {
+    hb_tag_t script;
+    GPtrArray *names;
+    GHashTable *seen;
+} ScriptFeatures;
+
+static void
+script_features_clear (gpointer data)
+{
+    ScriptFeatures *features = data;
+
+    g_ptr_array_unref (features->names);
+    g_hash_table_unref (features->seen);
+}
+
+static ScriptFeatures *
+lookup_script_features (GArray *scripts,
+                        hb_tag_t script)
+{
+    ScriptFeatures features;
+    guint idx;
+
+    for (idx = 0; idx < scripts->len; idx++) {
+        if (g_array_index (scripts, ScriptFeatures, idx).script == script)
+            return &g_array_index (scripts, ScriptFeatures, idx);
+    }
+
+    features.script = script;
+    features.names = g_ptr_array_new ();
+    features.seen = g_hash_table_new (NULL, NULL);
+    g_array_append_val (scripts, features);
+
+    return &g_array_index (scripts, ScriptFeatures, scripts->len - 1);
+}
+
+#define TAGS_PER_CALL 32
+
+static void
+collect_language_features (hb_face_t *hb_face,
+                           hb_tag_t table,
+                           guint script_index,
+                           guint language_index,
+                           ScriptFeatures *features)
+{
+    GHashTable *feature_names = get_feature_names ();
+    hb_tag_t tags[TAGS_PER_CALL];
+    guint i, offset = 0, count, total;
+
+    do {
+        count = G_N_ELEMENTS (tags);
+        total = hb_ot_layout_language_get_feature_tags (hb_face, table,
+                                                        script_index, language_index,
+                                                        offset, &count, tags);
+        for (i = 0; i < count; i++) {
+            const gchar *name;
+
+            if (!g_hash_table_add (features->seen, GUINT_TO_POINTER (tags[i])))
+                continue;
+
+            name = g_hash_table_lookup (feature_names, GUINT_TO_POINTER (tags[i]));
+            if (name != NULL)
+                g_ptr_array_add (features->names, (gpointer) name);
+        }
+
+        offset += count;
+    } while (count > 0 && offset < total);
+}
+
+/* Walks every language system of every script in @table. */
+static void
+collect_table_features (hb_face_t *hb_face,
+                        hb_tag_t table,
+                        GArray *scripts)
+{
+    hb_tag_t tags[TAGS_PER_CALL];
+    guint i, offset = 0, count, total;
+
+    do {
+        count = G_N_ELEMENTS (tags);
+        total = hb_ot_layout_table_get_script_tags (hb_face, table, offset, &count, tags);
+
+        for (i = 0; i < count; i++) {
+            ScriptFeatures *features = lookup_script_features (scripts, tags[i]);
+            guint language_index, n_languages, none = 0;
+
+            n_languages = hb_ot_layout_script_get_language_tags (hb_face, table, offset + i,
+                                                                 0, &none, NULL);
+
+            collect_language_features (hb_face, table, offset + i,
+                                       HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX, features);
+            for (language_index = 0; language_index < n_languages; language_index++)
+                collect_language_features (hb_face, table, offset + i,
+                                           language_index, features);
+        }
+
+        offset += count;
+    } while (count > 0 && offset < total);
+}
+
+static void
+free_string (gpointer data)
+{
+    g_string_free (data, TRUE);
+}
+
+static gchar *
+join_feature_names (GPtrArray *names)
+{
+    GString *s = g_string_new ("");
+    guint idx;
+
+    for (idx = 0; idx < names->len; idx++) {
+        if (s->len > 0)
+            g_string_append (s, C_("OpenType layout", ", "));
+        g_string_append (s, g_dpgettext2 (NULL, "OpenType layout", g_ptr_array_index (names, idx)));
+    }
+
+    return g_string_free (s, FALSE);
+}
+
+/* Lists the named layout features of every script, one line per group
+ * of scripts with the same features, such as "cyrl, latn: Kerning". A
+ * font whose scripts all agree gets just the list. */
+static char *
+get_features (hb_face_t *hb_face)
+{
+    g_autoptr(GArray) scripts = NULL;
+    g_autoptr(GPtrArray) lines = NULL;
+    g_autoptr(GPtrArray) line_scripts = NULL;
+    g_autoptr(GHashTable) line_indexes = NULL;
+    g_autoptr(GString) s = NULL;
+    hb_tag_t tables[2] = { HB_OT_TAG_GSUB, HB_OT_TAG_GPOS };
+    guint i;
+
+    if (hb_face == NULL)
+        return NULL;
+
+    scripts = g_array_new (FALSE, FALSE, sizeof (ScriptFeatures));
+    g_array_set_clear_func (scripts, script_features_clear);
+
+    for (i = 0; i < G_N_ELEMENTS (tables); i++)
+        collect_table_features (hb_face, tables[i], scripts);
+
+    lines = g_ptr_array_new_with_free_func (g_free);
+    line_scripts = g_ptr_array_new_with_free_func (free_string);
+    line_indexes = g_hash_table_new (g_str_hash, g_str_equal);
+
+    for (i = 0; i < scripts->len; i++) {
+        ScriptFeatures *features = &g_array_index (scripts, ScriptFeatures, i);
+        gchar *line, script[5] = { 0, };
+        gpointer line_index;
+
+        if (features->names->len == 0)
+            continue;
+
+        hb_tag_to_string (features->script, script);
+        line = join_feature_names (features->names);
+
+        if (g_hash_table_lookup_extended (line_indexes, line, NULL, &line_index)) {
+            GString *tags = g_ptr_array_index (line_scripts, GPOINTER_TO_UINT (line_index));
+
+            g_string_append_printf (tags, ", %s", script);
+            g_free (line);
+            continue;
+        }
+
+        g_hash_table_insert (line_indexes, line, GUINT_TO_POINTER (lines->len));
+        g_ptr_array_add (lines, line);
+        g_ptr_array_add (line_scripts, g_string_new (script));
+    }
+
+    if (lines->len == 0)
+        return NULL;
+
+    if (lines->len == 1)
+        return g_strdup (g_ptr_array_index (lines, 0));
+
+    s = g_string_new ("");
+    for (i = 0; i < lines->len; i++) {
+        GString *tags = g_ptr_array_index (line_scripts, i);
+
+        if (s->len > 0)
+            g_string_append_c (s, '\n');
+        g_string_append_printf (s, "%s: %s", tags->str, (gchar *) g_ptr_array_index (lines, i));
+    }
+
+    return g_strdup (s->str);
+}
+
+static void
+add_general_rows (FontInfo *self,
+                  GFile *file,
+                  FT_Face face,
+                  NameTable *names,
+                  GFileInfo *file_info)
+{
+    g_autofree gchar *path = NULL;
+    PS_FontInfoRec ps_info;
+
+    add_row (self, _("Name"), face->family_name, FALSE);
+
+    path = g_file_get_path (file);
+    add_row (self, _("Location"), path, FALSE);
+
+    if (face->style_name)
+        add_row (self, _("Style"), face->style_name, FALSE);
+
+    if (file_info != NULL) {
+        g_autofree gchar *s = g_content_type_get_description (g_file_info_get_content_type (file_info));
+        add_row (self, _("Type"), s, FALSE);
+    }
+
+    if (FT_IS_SFNT (face)) {
+        g_autofree gchar *version = NULL, *copyright = NULL, *description = NULL;
+        g_autofree gchar *designer = NULL, *manufacturer = NULL, *license = NULL;
+
+        version = g_strdup (name_table_lookup (names, TT_NAME_ID_VERSION_STRING));
+        copyright = g_strdup (name_table_lookup (names, TT_NAME_ID_COPYRIGHT));
+        description = g_strdup (name_table_lookup (names, TT_NAME_ID_DESCRIPTION));
+        manufacturer = g_strdup (name_table_lookup (names, TT_NAME_ID_MANUFACTURER));
+        designer = g_strdup (name_table_lookup (names, TT_NAME_ID_DESIGNER));
+        license = g_strdup (name_table_lookup (names, TT_NAME_ID_LICENSE));
+
+        if (version) {
+            strip_version (&version);
+            add_row (self, _("Version"), version, FALSE);
+        }
+        if (copyright) {
+            strip_whitespace (&copyright);
+            add_row (self, _("Copyright"), copyright, TRUE);
+        }
+        if (description) {
+            strip_whitespace (&description);
+            add_row (self, _("Description"), description, TRUE);
+        }
+        if (manufacturer) {
+            strip_whitespace (&manufacturer);
+            add_row (self, _("Manufacturer"), manufacturer, TRUE);
+        }
+        if (designer) {
+            strip_whitespace (&designer);
+            add_row (self, _("Designer"), designer, TRUE);
+        }
+        if (license) {
+            strip_whitespace (&license);
+            add_row (self, _("License"), license, TRUE);
+        }
+    } else if (FT_Get_PS_Font_Info (face, &ps_info) == 0) {
+        if (ps_info.version && g_utf8_validate (ps_info.version, -1, NULL)) {
+            g_autofree gchar *compressed = g_strcompress (ps_info.version);
+            strip_version (&compressed);
+            add_row (self, _("Version"), compressed, FALSE);
+        }
+        if (ps_info.notice && g_utf8_validate (ps_info.notice, -1, NULL)) {
+            g_autofree gchar *compressed = g_strcompress (ps_info.notice);
+            strip_whitespace (&compressed);
+            add_row (self, _("Copyright"), compressed, TRUE);
+        }
+    }
+}
+
+static void
+add_detail_rows (FontInfo *self,
+                 FT_Face face,
+                 NameTable *names)
+{
+    g_autofree gchar *glyph_count = NULL, *features = NULL;
+    FT_MM_Var *ft_mm_var;
+    hb_face_t *hb_face;
+
+    glyph_count = g_strdup_printf ("%ld", face->num_glyphs);
+    add_row (self, _("Glyph Count"), glyph_count, FALSE);
+
+    add_row (self, _("Color Glyphs"), FT_HAS_COLOR (face) ? _("yes") : _("no"), FALSE);
+
+    /* Not the preview's face: that one reads tables through an FT_Face
+     * the main thread renders with, which this thread must not touch. */
+    hb_face = hb_ft_face_create_referenced (face);
+    features = get_features (hb_face);
+    hb_face_destroy (hb_face);
+    if (features)
+        add_row (self, _("Layout Features"), features, TRUE);
+
+    if (FT_Get_MM_Var (face, &ft_mm_var) == 0) {
+        int i;
+        for (i = 0; i < ft_mm_var->num_axis; i++) {
+            g_autofree gchar *s = describe_axis (&ft_mm_var->axis[i]);
+            add_row (self, i == 0 ? _("Variation Axes") : "", s, FALSE);
+        }
+        {
+            g_autoptr(GString) str = g_string_new ("");
+            for (i = 0; i < ft_mm_var->num_namedstyles; i++)
+                describe_instance (names, &ft_mm_var->namedstyle[i], i, str);
+
+            add_row (self, _("Named Styles"), str->str, TRUE);
+        }
+        free (ft_mm_var);
+    }
+}
+
+static void
+free_thread_library (gpointer data)
+{
+    FT_Done_FreeType (data);
+}
+
+static GPrivate thread_library = G_PRIVATE_INIT (free_thread_library);
+
+/* A FreeType library must not be used by two threads at once, so each
+ * worker has its own. */
+static FT_Library
+get_thread_library (void)
+{
+    FT_Library library = g_private_get (&thread_library);
+
+    if (library == NULL) {
+        if (FT_Init_FreeType (&library) != FT_Err_Ok)
+            return NULL;
+
+        g_private_set (&thread_library, library);
+    }
+
+    return library;
+}
+
+static void
+font_info_job_free (FontInfoJob *job)
+{
+    g_clear_object (&job->file);
+    g_slice_free (FontInfoJob, job);
+}
+
+static gchar *
+info_cache_key (GFile *file,
+                gint face_index,
+                GFileInfo *file_info)
+{
+    g_autofree gchar *uri = g_file_get_uri (file);
+    guint64 mtime;
+
+    mtime = g_file_info_get_attribute_uint64 (file_info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+    return g_strdup_printf ("%s:%d:%" G_GUINT64_FORMAT, uri, face_index, mtime);
+}
+
+static FontInfo *
+info_cache_lookup (const gchar *key)
+{
+    gpointer stored_key, info = NULL;
+
+    G_LOCK (info_cache);
+
+    if (info_cache != NULL &&
+        g_hash_table_lookup_extended (info_cache, key, &stored_key, &info)) {
+        g_queue_remove (&info_cache_lru, stored_key);
+        g_queue_push_head (&info_cache_lru, stored_key);
+        font_info_ref (info);
+    }
+
+    G_UNLOCK (info_cache);
+
+    return info;
+}
+
+static void
+info_cache_insert (const gchar *key,
+                   FontInfo *info)
+{
+    gchar *stored_key;
+
+    G_LOCK (info_cache);
+
+    if (info_cache == NULL)
+        info_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify) font_info_unref);
+
+    if (!g_hash_table_contains (info_cache, key)) {
+        stored_key = g_strdup (key);
+        g_hash_table_insert (info_cache, stored_key, font_info_ref (info));
+        g_queue_push_head (&info_cache_lru, stored_key);
+
+        while (info_cache_lru.length > MAX_CACHED_INFOS)
+            g_hash_table_remove (info_cache, g_queue_pop_tail (&info_cache_lru));
+    }
+
+    G_UNLOCK (info_cache);
+}
+
+/* Opening the face, and querying the file, can take a while for large
+ * variable fonts and files on network mounts. */
+static void
+load_font_info (GTask *task,
+                gpointer source_object,
+                gpointer task_data,
+                GCancellable *cancellable)
+{
+    FontInfoJob *job = task_data;
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GFileInfo) file_info = NULL;
+    g_autofree gchar *uri = NULL;
+    g_autofree gchar *key = NULL;
+    GBytes *contents = NULL;
+    FT_Library library;
+    FT_Face face;
+    NameTable names;
+    FontInfo *info;
+
+    if (g_task_return_error_if_cancelled (task))
+        return;
+
+    /* A file replaced in place keeps its URI; without its modification
+     * time the details are read afresh every time. */
+    file_info = g_file_query_info (job->file,
+                                   G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
+                                   G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+                                   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                   G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+    if (file_info != NULL) {
+        key = info_cache_key (job->file, job->face_index, file_info);
+        info = info_cache_lookup (key);
+        if (info != NULL) {
+            g_task_return_pointer (task, info, (GDestroyNotify) font_info_unref);
+            return;
+        }
+    }
+
+    library = get_thread_library ();
+    if (library == NULL) {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "Unable to initialize FreeType");
+        return;
+    }
+
+    uri = g_file_get_uri (job->file);
+    face = sushi_new_ft_face_from_uri (library, uri, job->face_index, &contents, &error);
+    if (face == NULL) {
+        g_task_return_error (task, g_steal_pointer (&error));
+        return;
+    }
+
+    name_table_init (&names, face);
+
+    info = font_info_new ();
+    add_general_rows (info, job->file, face, &names, file_info);
+    add_detail_rows (info, face, &names);
+
+    name_table_clear (&names);
+
+    FT_Done_Face (face);
+    g_bytes_unref (contents);
+
+    if (key != NULL)
+        info_cache_insert (key, info);
+
+    g_task_return_pointer (task, info, (GDestroyNotify) font_info_unref);
+}
+
+/* Reads the details of face @face_index of @file in a worker, or takes
+ * them from the cache if they were read before from the same version
+ * of the file. */
+void
+font_info_load_async (GFile *file,
+                      gint face_index,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+    g_autoptr(GTask) task = g_task_new (NULL, cancellable, callback, user_data);
+    FontInfoJob *job;
+
+    g_task_set_source_tag (task, font_info_load_async);
+
+    job = g_slice_new0 (FontInfoJob);
+    job->file = g_object_ref (file);
+    job->face_index = face_index;
+
+    g_task_set_task_data (task, job, (GDestroyNotify) font_info_job_free);
+    g_task_set_return_on_cancel (task, TRUE);
+    g_task_run_in_thread (task, load_font_info);
+}
+
+FontInfo *
+font_info_load_finish (GAsyncResult *result,
+                       GError **error)
+{
+    return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,47 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_INFO_H__
+#define __FONT_INFO_H__
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FontInfo FontInfo;
+
+void font_info_load_async (GFile *file,
+                           gint face_index,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+
+FontInfo *font_info_load_finish (GAsyncResult *result,
+                                 GError **error);
+
+FontInfo *font_info_ref (FontInfo *self);
+void font_info_unref (FontInfo *self);
+
+guint font_info_get_n_rows (FontInfo *self);
+const gchar *font_info_get_row (FontInfo *self,
+                                guint idx,
+                                const gchar **value,
+                                gboolean *multiline);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontInfo, font_info_unref)
+
+G_END_DECLS
+
+#endif /* __FONT_INFO_H__ */
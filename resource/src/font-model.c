@@ -24,37 +24,85 @@
 
 /* Portions of this code may have been edited from the original. */
 
+
 #include <gio/gio.h>
 #include <gtk/gtk.h>
 
+#include <string.h>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <fontconfig/fontconfig.h>
 
+#include "font-catalog.h"
+#include "font-coverage.h"
 #include "font-model.h"
+#include "font-search-index.h"
+#include "font-store.h"
 #include "sushi-font-loader.h"
 
+/* The installed fonts, as a list model. The fonts themselves live in a
+ * compact store that is built off the main thread; items are small
+ * wrappers created when a view asks for a position, and only kept as
+ * long as the view holds on to them.
+ */
+
 struct _FontViewModel
 {
     GObject parent_instance;
-    FcFontSet *font_list;
-    GMutex font_list_mutex;
-    FT_Library library;
-    GListStore *model;
+    /* The fonts of the last load, sorted by collation key. An entry's
+     * id in the store is its position in the model. */
+    FontStore *store;
+    guint n_items;
+    /* While views are told about a new store run by run: the store
+     * being replaced, and where the runs got to in it and in @store.
+     * Positions before @new_end are in @store, later ones in
+     * @old_store. */
+    FontStore *old_store;
+    guint old_end;
+    guint new_end;
+    /* Position -> the live item handed out for it, unowned. */
+    GHashTable *items;
+    /* Over the names in @store, by entry. */
+    FontSearchIndex *search_index;
+    /* Codepoint coverage of the fonts, built after them, and the store
+     * whose entries it is indexed by; until a reload's coverage is
+     * built, that is the store before it. */
+    FontCoverage *coverage;
+    FontStore *coverage_store;
     GCancellable *cancellable;
+    GCancellable *coverage_cancellable;
     guint font_list_idle_id;
+    guint font_list_update_id;
     guint fontconfig_update_id;
+    gboolean font_list_loaded;
+};
+
+static void font_view_model_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (FontViewModel, font_view_model, G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL,
+                                                font_view_model_list_model_init))
+
+enum {
+    COVERAGE_CHANGED,
+    NUM_SIGNALS
 };
 
-G_DEFINE_TYPE (FontViewModel, font_view_model, G_TYPE_OBJECT)
+static guint signals[NUM_SIGNALS] = { 0, };
+
+/* Fontconfig changes tend to come in bursts, e.g. while a package
+ * installs a font family file by file. */
+#define FONT_LIST_UPDATE_DELAY_MS 500
 
 struct _FontViewModelItem
 {
     GObject parent_instance;
-    gchar *collation_key;
-    gchar *font_name;
+    /* Fields are read from the store the item was created from, which
+     * it keeps alive. */
+    FontStore *store;
+    guint id;
     GFile *file;
-    int face_index;
 };
 
 G_DEFINE_TYPE (FontViewModelItem, font_view_model_item, G_TYPE_OBJECT)
@@ -63,8 +111,7 @@ static void
 font_view_model_item_finalize (GObject *obj)
 {
     FontViewModelItem *self = FONT_VIEW_MODEL_ITEM (obj);
-    g_clear_pointer (&self->collation_key, g_free);
-    g_clear_pointer (&self->font_name, g_free);
+    g_clear_pointer (&self->store, font_store_unref);
     g_clear_object (&self->file);
     G_OBJECT_CLASS (font_view_model_item_parent_class)->finalize (obj);
 }
@@ -82,69 +129,372 @@ font_view_model_item_init (FontViewModelItem *self)
 }
 
 static FontViewModelItem *
-font_view_model_item_new (const gchar *font_name,
-                          GFile       *file,
-                          int          face_index)
+font_view_model_item_new (FontStore *store,
+                          guint id)
 {
     FontViewModelItem *item = g_object_new (FONT_VIEW_TYPE_MODEL_ITEM, NULL);
-    item->collation_key = g_utf8_collate_key (font_name, -1);
-    item->font_name = g_strdup (font_name);
-    item->file = g_object_ref (file);
-    item->face_index = face_index;
+    item->store = font_store_ref (store);
+    item->id = id;
     return item;
 }
 
 const gchar *
 font_view_model_item_get_collation_key (FontViewModelItem *self)
 {
-    return self->collation_key;
+    return font_store_get_collation_key (self->store, self->id);
 }
 
 const gchar *
 font_view_model_item_get_font_name (FontViewModelItem *self)
 {
-    return self->font_name;
+    return font_store_get_font_name (self->store, self->id);
 }
 
 GFile *
 font_view_model_item_get_font_file (FontViewModelItem *self)
 {
+    if (self->file == NULL) {
+        g_autofree gchar *path = font_store_dup_path (self->store, self->id);
+        self->file = g_file_new_for_path (path);
+    }
+
     return self->file;
 }
 
 gint
 font_view_model_item_get_face_index (FontViewModelItem *self)
 {
-    return self->face_index;
+    return font_store_get_face_index (self->store, self->id);
+}
+
+static gboolean
+is_item (gpointer key,
+         gpointer value,
+         gpointer user_data)
+{
+    return value == user_data;
+}
+
+static void
+item_disposed (gpointer data,
+               GObject *where_the_object_was)
+{
+    FontViewModel *self = data;
+
+    g_hash_table_foreach_remove (self->items, is_item, where_the_object_was);
+}
+
+/* Finds the store entry at @position. */
+static FontStore *
+font_view_model_get_entry (FontViewModel *self,
+                           guint position,
+                           guint *id)
+{
+    if (self->old_store != NULL && position >= self->new_end) {
+        *id = position - self->new_end + self->old_end;
+        return self->old_store;
+    }
+
+    *id = position;
+    return self->store;
+}
+
+static GType
+font_view_model_get_item_type (GListModel *list)
+{
+    return FONT_VIEW_TYPE_MODEL_ITEM;
+}
+
+static guint
+font_view_model_get_n_items (GListModel *list)
+{
+    return FONT_VIEW_MODEL (list)->n_items;
+}
+
+static gpointer
+font_view_model_get_item (GListModel *list,
+                          guint position)
+{
+    FontViewModel *self = FONT_VIEW_MODEL (list);
+    FontViewModelItem *item;
+    FontStore *store;
+    guint id;
+
+    if (position >= self->n_items)
+        return NULL;
+
+    item = g_hash_table_lookup (self->items, GUINT_TO_POINTER (position));
+    if (item != NULL)
+        return g_object_ref (item);
+
+    store = font_view_model_get_entry (self, position, &id);
+    item = font_view_model_item_new (store, id);
+    g_object_weak_ref (G_OBJECT (item), item_disposed, self);
+    g_hash_table_insert (self->items, GUINT_TO_POINTER (position), item);
+
+    return item;
+}
+
+static void
+font_view_model_list_model_init (GListModelInterface *iface)
+{
+    iface->get_item_type = font_view_model_get_item_type;
+    iface->get_n_items = font_view_model_get_n_items;
+    iface->get_item = font_view_model_get_item;
 }
 
+/* Moves the live items after a change of @removed items at @position
+ * to @added new ones. Items stay valid wherever they are, as they
+ * read from the store they were created from. */
+static void
+font_view_model_splice_items (FontViewModel *self,
+                              guint position,
+                              guint removed,
+                              guint added)
+{
+    g_autoptr(GHashTable) old_items = g_steal_pointer (&self->items);
+    GHashTableIter iter;
+    gpointer key, item;
+
+    self->items = g_hash_table_new (NULL, NULL);
+
+    g_hash_table_iter_init (&iter, old_items);
+    while (g_hash_table_iter_next (&iter, &key, &item)) {
+        guint item_position = GPOINTER_TO_UINT (key);
+
+        if (item_position < position)
+            g_hash_table_insert (self->items, key, item);
+        else if (item_position >= position + removed)
+            g_hash_table_insert (self->items,
+                                 GUINT_TO_POINTER (item_position - removed + added), item);
+        else
+            g_object_weak_unref (item, item_disposed, self);
+    }
+}
+
+/* Switches to @store, telling views only about the fonts that changed.
+ * Both stores are sorted the same way, so walking them side by side
+ * pairs up the unchanged fonts; each run of changes between them is
+ * one splice, and a font installed or removed is a single item.
+ */
+static void
+font_view_model_set_store (FontViewModel *self,
+                           FontStore *store)
+{
+    g_autoptr(FontStore) old_store = g_steal_pointer (&self->store);
+    guint old_n_items, n_items = font_store_get_n_entries (store);
+    guint i = 0, j = 0;
+
+    self->store = font_store_ref (store);
+
+    if (old_store == NULL) {
+        self->n_items = n_items;
+        if (n_items > 0)
+            g_list_model_items_changed (G_LIST_MODEL (self), 0, 0, n_items);
+        return;
+    }
+
+    old_n_items = font_store_get_n_entries (old_store);
+    self->old_store = old_store;
+    self->old_end = 0;
+    self->new_end = 0;
+
+    for (;;) {
+        guint run_i, run_j, removed, added;
+
+        while (i < old_n_items && j < n_items &&
+               font_store_entry_equal (old_store, i, store, j)) {
+            i++;
+            j++;
+        }
+
+        run_i = i;
+        run_j = j;
+
+        while (i < old_n_items || j < n_items) {
+            gint result;
+
+            if (i == old_n_items)
+                result = 1;
+            else if (j == n_items)
+                result = -1;
+            else if (font_store_entry_equal (old_store, i, store, j))
+                break;
+            else
+                result = font_store_entry_compare (old_store, i, store, j);
+
+            /* The same face under a new name is replaced. */
+            if (result <= 0)
+                i++;
+            if (result >= 0)
+                j++;
+        }
+
+        removed = i - run_i;
+        added = j - run_j;
+        if (removed == 0 && added == 0)
+            break;
+
+        font_view_model_splice_items (self, run_j, removed, added);
+        self->old_end = i;
+        self->new_end = j;
+        self->n_items = self->n_items - removed + added;
+
+        g_list_model_items_changed (G_LIST_MODEL (self), run_j, removed, added);
+    }
+
+    self->old_store = NULL;
+}
+
+/* Whether a font with the same short name as @face is installed. */
 gboolean
 font_view_model_has_face (FontViewModel *self,
                           FT_Face face)
 {
-    guint n_items;
-    gint idx;
-    g_autofree gchar *match_name = NULL;
-    n_items = g_list_model_get_n_items (G_LIST_MODEL (self->model));
-    match_name = sushi_get_font_name (face, TRUE);
+    g_autofree gchar *match_name = sushi_get_font_name (face, TRUE);
 
-    for (idx = 0; idx < n_items; idx++) {
-        FontViewModelItem *item = g_list_model_get_item (G_LIST_MODEL (self->model), idx);
-        if (g_strcmp0 (item->font_name, match_name) == 0)
-            return TRUE;
+    return self->store != NULL && font_store_has_font_name (self->store, match_name);
+}
+
+/* Whether face @face_index of @file is one of the installed fonts. */
+gboolean
+font_view_model_has_file (FontViewModel *self,
+                          GFile *file,
+                          gint face_index)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *canonical = NULL;
+
+    if (self->store == NULL)
+        return FALSE;
+
+    /* Non-native files can still have a local path, through FUSE. */
+    path = g_file_get_path (file);
+    if (path == NULL)
+        return FALSE;
+
+    canonical = font_store_canonicalize_path (path);
+    return font_store_find (self->store, canonical, face_index) >= 0;
+}
+
+typedef struct {
+    FontStore *store;
+    FontSearchIndex *search_index;
+} FontListResult;
+
+static void
+font_list_result_free (FontListResult *result)
+{
+    g_clear_pointer (&result->store, font_store_unref);
+    g_clear_pointer (&result->search_index, font_search_index_free);
+    g_slice_free (FontListResult, result);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontListResult, font_list_result_free)
+
+/* Runs in the loading thread, so searching never has to scan the
+ * names on the main thread. */
+static FontListResult *
+font_list_result_new (FontStore *store)
+{
+    FontListResult *result = g_slice_new0 (FontListResult);
+    guint id;
+
+    result->store = store;
+    result->search_index = font_search_index_new ();
+
+    for (id = 0; id < font_store_get_n_entries (store); id++)
+        font_search_index_add (result->search_index, font_store_get_font_name (store, id));
+
+    return result;
+}
+
+static void
+coverage_loaded (GObject *source_object,
+                 GAsyncResult *res,
+                 gpointer user_data)
+{
+    FontViewModel *self = FONT_VIEW_MODEL (source_object);
+    FontStore *store = g_task_get_task_data (G_TASK (res));
+    FontCoverage *coverage = g_task_propagate_pointer (G_TASK (res), NULL);
+
+    if (coverage == NULL)
+        return;
+
+    g_clear_pointer (&self->coverage, font_coverage_free);
+    g_clear_pointer (&self->coverage_store, font_store_unref);
+    self->coverage = coverage;
+    self->coverage_store = font_store_ref (store);
+
+    g_signal_emit (self, signals[COVERAGE_CHANGED], 0);
+}
+
+static void
+load_coverage (GTask *task,
+               gpointer source_object,
+               gpointer user_data,
+               GCancellable *cancellable)
+{
+    FontStore *store = user_data;
+    guint id, n_entries = font_store_get_n_entries (store);
+    g_autoptr(GPtrArray) paths = g_ptr_array_new_full (n_entries, g_free);
+    g_autofree gint *face_indexes = g_new (gint, n_entries);
+    FontCoverage *coverage;
+
+    for (id = 0; id < n_entries; id++) {
+        g_ptr_array_add (paths, font_store_dup_path (store, id));
+        face_indexes[id] = font_store_get_face_index (store, id);
     }
 
-    return FALSE;
+    coverage = font_coverage_build ((const gchar * const *) paths->pdata, face_indexes,
+                                    n_entries, cancellable);
+    if (coverage == NULL) {
+        g_task_return_error_if_cancelled (task);
+        return;
+    }
+
+    g_task_return_pointer (task, coverage, (GDestroyNotify) font_coverage_free);
+}
+
+/* Coverage is only needed once the user filters by it, so it is built
+ * after the list, at low priority, and never holds the overview up. */
+static void
+ensure_coverage (FontViewModel *self,
+                 FontStore *store)
+{
+    g_autoptr(GTask) task = NULL;
+
+    g_cancellable_cancel (self->coverage_cancellable);
+    g_clear_object (&self->coverage_cancellable);
+    self->coverage_cancellable = g_cancellable_new ();
+
+    task = g_task_new (self, self->coverage_cancellable, coverage_loaded, NULL);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_set_return_on_cancel (task, TRUE);
+    g_task_set_task_data (task, font_store_ref (store), (GDestroyNotify) font_store_unref);
+    g_task_run_in_thread (task, load_coverage);
 }
 
 static void
 font_infos_loaded (GObject *source_object,
-                   GAsyncResult *result,
+                   GAsyncResult *res,
                    gpointer user_data)
 {
     FontViewModel *self = FONT_VIEW_MODEL (source_object);
-    g_autoptr(GPtrArray) items = g_task_propagate_pointer (G_TASK (result), NULL);
-    g_list_store_splice (self->model, 0, 0, items->pdata, items->len);
+    g_autoptr(FontListResult) result = g_task_propagate_pointer (G_TASK (res), NULL);
+
+    /* Superseded by a newer load. */
+    if (result == NULL)
+        return;
+
+    g_clear_pointer (&self->search_index, font_search_index_free);
+    self->search_index = g_steal_pointer (&result->search_index);
+
+    ensure_coverage (self, result->store);
+
+    /* However many fonts there are, this only publishes the store; the
+     * views create items for what they show. */
+    font_view_model_set_store (self, result->store);
 }
 
 static const gchar* weight_to_name(int weight) {
@@ -201,63 +551,258 @@ build_font_name (const char *style_name, const char *family_name, int slant, int
   return g_strconcat (family_name, ", ", style_name_x, NULL);
 }
 
+
+/* Warm start: the catalog on disk is still valid, so build the store
+ * from it without asking fontconfig for anything. */
+static void
+load_font_infos_from_catalog (GTask *task,
+                              gpointer source_object,
+                              gpointer user_data,
+                              GCancellable *cancellable)
+{
+    FontCatalog *catalog = user_data;
+    g_autoptr(FontStoreBuilder) builder = font_store_builder_new ();
+    guint i, n_fonts;
+
+    n_fonts = font_catalog_get_n_entries (catalog);
+
+    for (i = 0; i < n_fonts; i++) {
+        if (g_task_return_error_if_cancelled (task))
+            return;
+
+        font_store_builder_add (builder,
+                                font_catalog_get_path (catalog, i),
+                                font_catalog_get_face_index (catalog, i),
+                                font_catalog_get_font_name (catalog, i),
+                                font_catalog_get_collation_key (catalog, i));
+    }
+
+    g_task_return_pointer (task,
+                           font_list_result_new (font_store_builder_end (g_steal_pointer (&builder))),
+                           (GDestroyNotify) font_list_result_free);
+}
+
+typedef struct {
+    FcFontSet *font_list;
+    gchar *stamp;
+} FontListJob;
+
+static void
+font_list_job_free (FontListJob *job)
+{
+    FcFontSetDestroy (job->font_list);
+    g_free (job->stamp);
+    g_slice_free (FontListJob, job);
+}
+
+/* One font as read from its pattern, before it goes into the store. */
+typedef struct {
+    /* Canonical, as font_view_model_has_file() looks it up. */
+    gchar *path;
+    gint face_index;
+    gchar *font_name;
+    gchar *collation_key;
+} FontRecord;
+
+static void
+font_record_clear (gpointer data)
+{
+    FontRecord *record = data;
+
+    g_free (record->path);
+    g_free (record->font_name);
+    g_free (record->collation_key);
+}
+
+static gboolean
+font_record_init_for_pattern (FontRecord *record,
+                              FcPattern *font)
+{
+    FcChar8 *path, *family, *style;
+    int index, slant, weight;
+    const gchar *family_name = NULL, *style_name = NULL;
+    gchar *font_name;
+
+    if (FcPatternGetString (font, FC_FILE, 0, &path) != FcResultMatch)
+        return FALSE;
+    if (FcPatternGetInteger (font, FC_INDEX, 0, &index) != FcResultMatch)
+        index = 0;
+    if (FcPatternGetString (font, FC_FAMILY, 0, &family) == FcResultMatch)
+        family_name = (const gchar *) family;
+    if (FcPatternGetString (font, FC_STYLE, 0, &style) == FcResultMatch)
+        style_name = (const gchar *) style;
+    if (FcPatternGetInteger (font, FC_SLANT, 0, &slant) != FcResultMatch)
+        slant = -1;
+    if (FcPatternGetInteger (font, FC_WEIGHT, 0, &weight) != FcResultMatch)
+        weight = -1;
+
+    font_name = build_font_name (style_name, family_name, slant, weight, TRUE);
+    if (!font_name)
+        return FALSE;
+
+    record->path = font_store_canonicalize_path ((const gchar *) path);
+    record->face_index = index;
+    record->font_name = font_name;
+    record->collation_key = g_utf8_collate_key (font_name, -1);
+
+    return TRUE;
+}
+
+/* Collation order, with ties broken by file so that the order, and the
+ * diff between two loads, is stable. */
+static gint
+font_record_compare (gconstpointer a,
+                     gconstpointer b)
+{
+    const FontRecord *record_a = a, *record_b = b;
+    gint result;
+
+    result = strcmp (record_a->collation_key, record_b->collation_key);
+    if (result == 0)
+        result = strcmp (record_a->path, record_b->path);
+    if (result == 0)
+        result = record_a->face_index - record_b->face_index;
+
+    return result;
+}
+
+/* A slice of the font list, turned into records by one worker. The font
+ * set is never modified once listed, so workers read it unlocked. */
+typedef struct {
+    FcFontSet *font_list;
+    gint start;
+    gint end;
+    GCancellable *cancellable;
+    GArray *records;
+} FontListChunk;
+
+#define MIN_FONTS_PER_CHUNK 256
+
+static gpointer
+load_font_list_chunk (gpointer data)
+{
+    FontListChunk *chunk = data;
+    gint i;
+
+    chunk->records = g_array_sized_new (FALSE, FALSE, sizeof (FontRecord),
+                                        chunk->end - chunk->start);
+    g_array_set_clear_func (chunk->records, font_record_clear);
+
+    for (i = chunk->start; i < chunk->end; i++) {
+        FontRecord record;
+
+        if (g_cancellable_is_cancelled (chunk->cancellable))
+            break;
+
+        if (font_record_init_for_pattern (&record, chunk->font_list->fonts[i]))
+            g_array_append_val (chunk->records, record);
+    }
+
+    g_array_sort (chunk->records, font_record_compare);
+
+    return NULL;
+}
+
+/* Merges the sorted chunks into a store in collation order. There is
+ * one chunk per core, so finding the smallest head by a linear scan is
+ * cheaper than keeping a heap.
+ */
+static FontStore *
+merge_font_list_chunks (FontListChunk *chunks,
+                        guint n_chunks)
+{
+    g_autoptr(FontStoreBuilder) builder = font_store_builder_new ();
+    g_autofree guint *heads = g_new0 (guint, n_chunks);
+    guint idx;
+
+    for (;;) {
+        FontRecord *best = NULL;
+        guint best_chunk = 0;
+
+        for (idx = 0; idx < n_chunks; idx++) {
+            FontRecord *record;
+
+            if (heads[idx] == chunks[idx].records->len)
+                continue;
+
+            record = &g_array_index (chunks[idx].records, FontRecord, heads[idx]);
+            if (best == NULL || font_record_compare (record, best) < 0) {
+                best = record;
+                best_chunk = idx;
+            }
+        }
+
+        if (best == NULL)
+            break;
+
+        font_store_builder_add (builder, best->path, best->face_index,
+                                best->font_name, best->collation_key);
+        heads[best_chunk]++;
+    }
+
+    return font_store_builder_end (g_steal_pointer (&builder));
+}
+
 static void
 load_font_infos (GTask *task,
                  gpointer source_object,
                  gpointer user_data,
                  GCancellable *cancellable)
 {
-    FontViewModel *self = FONT_VIEW_MODEL (source_object);
-    g_autoptr(GPtrArray) items = NULL;
-    gint i, n_fonts;
+    FontListJob *job = user_data;
+    g_autoptr(FontCatalogWriter) writer = NULL;
+    g_autoptr(FontStore) store = NULL;
+    g_autoptr(GError) error = NULL;
+    g_autofree FontListChunk *chunks = NULL;
+    g_autofree GThread **threads = NULL;
+    gint n_fonts, chunk_size;
+    guint idx, n_chunks;
+
+    n_fonts = job->font_list->nfont;
+    n_chunks = CLAMP (n_fonts / MIN_FONTS_PER_CHUNK, 1, g_get_num_processors ());
+    chunk_size = (n_fonts + n_chunks - 1) / n_chunks;
+
+    chunks = g_new0 (FontListChunk, n_chunks);
+    threads = g_new0 (GThread *, n_chunks);
+
+    for (idx = 0; idx < n_chunks; idx++) {
+        chunks[idx].font_list = job->font_list;
+        chunks[idx].start = MIN (idx * chunk_size, n_fonts);
+        chunks[idx].end = MIN ((idx + 1) * chunk_size, n_fonts);
+        chunks[idx].cancellable = cancellable;
+    }
 
-    n_fonts = self->font_list->nfont;
-    items = g_ptr_array_new_full (n_fonts, g_object_unref);
+    /* The first chunk runs on this thread. */
+    for (idx = 1; idx < n_chunks; idx++)
+        threads[idx] = g_thread_new ("font-list", load_font_list_chunk, &chunks[idx]);
+    load_font_list_chunk (&chunks[0]);
+    for (idx = 1; idx < n_chunks; idx++)
+        g_thread_join (threads[idx]);
 
-    for (i = 0; i < n_fonts; i++) {
-        FontViewModelItem *item;
-        FcChar8 *path, *family, *style;
-        int index, slant, weight;
-        g_autofree gchar *font_name = NULL;
-        g_autoptr(GFile) file = NULL;
+    if (!g_cancellable_is_cancelled (cancellable))
+        store = merge_font_list_chunks (chunks, n_chunks);
 
-        if (g_task_return_error_if_cancelled (task))
-            return;
+    for (idx = 0; idx < n_chunks; idx++)
+        g_array_unref (chunks[idx].records);
 
-        g_mutex_lock (&self->font_list_mutex);
-        FcPattern* font = self->font_list->fonts[i];
-        FcPatternGetString (font, FC_FILE, 0, &path);
-        FcPatternGetInteger (font, FC_INDEX, 0, &index);
-        g_autofree gchar *style_name = NULL;
-        g_autofree gchar *family_name = NULL;
-        FcResult result = FcPatternGetString(font, FC_FAMILY, 0, &family);
-        if (result == FcResultMatch) {
-            family_name = g_strdup((const gchar*) family);
-        }
-        result = FcPatternGetString(font, FC_STYLE, 0, &style);
-        if (result == FcResultMatch) {
-            style_name = g_strdup((const gchar*) style);
-        }
-        result = FcPatternGetInteger(font, FC_SLANT, 0, &slant);
-        if (result != FcResultMatch) {
-            slant = -1;
-        }
-        result = FcPatternGetInteger(font, FC_WEIGHT, 0, &weight);
-        if (result != FcResultMatch) {
-            weight = -1;
-        }
-        g_mutex_unlock (&self->font_list_mutex);
+    if (g_task_return_error_if_cancelled (task))
+        return;
 
-        file = g_file_new_for_path ((const gchar *) path);
-        font_name = build_font_name(style_name, family_name, slant, weight, TRUE);
-        if (!font_name)
-            continue;
+    writer = font_catalog_writer_new ();
+    for (idx = 0; idx < font_store_get_n_entries (store); idx++) {
+        g_autofree gchar *path = font_store_dup_path (store, idx);
 
-        item = font_view_model_item_new (font_name, file, index);
-        g_ptr_array_add (items, item);
+        font_catalog_writer_add (writer, path,
+                                 font_store_get_face_index (store, idx),
+                                 font_store_get_font_name (store, idx),
+                                 font_store_get_collation_key (store, idx));
     }
 
-    g_task_return_pointer (task, g_steal_pointer (&items), NULL);
+    if (!font_catalog_writer_save (writer, job->stamp, &error))
+        g_warning ("Can't save the font catalog: %s", error->message);
+
+    g_task_return_pointer (task, font_list_result_new (g_steal_pointer (&store)),
+                           (GDestroyNotify) font_list_result_free);
 }
 
 static void
@@ -266,38 +811,55 @@ ensure_font_list (FontViewModel *self)
     FcPattern *pat;
     FcObjectSet *os;
     g_autoptr(GTask) task = NULL;
+    g_autofree gchar *stamp = NULL;
+    FontCatalog *catalog;
+    FcFontSet *font_list = NULL;
 
-    if (!FcInitReinitialize())
+    /* The application has just initialized fontconfig on startup; only
+     * later updates need to pick up a changed configuration. */
+    if (self->font_list_loaded && !FcInitReinitialize())
         return;
 
+    self->font_list_loaded = TRUE;
+
     g_cancellable_cancel (self->cancellable);
     g_clear_object (&self->cancellable);
 
-    g_list_store_remove_all (self->model);
+    stamp = font_catalog_compute_stamp ();
+    catalog = font_catalog_open (stamp);
 
-    pat = FcPatternCreate ();
-    os = FcObjectSetBuild (FC_FILE, FC_INDEX, FC_FAMILY, FC_WEIGHT, FC_SLANT, NULL);
+    if (catalog == NULL) {
+        pat = FcPatternCreate ();
+        os = FcObjectSetBuild (FC_FILE, FC_INDEX, FC_FAMILY, FC_WEIGHT, FC_SLANT, NULL);
 
-    g_mutex_lock (&self->font_list_mutex);
+        FcPatternAddBool (pat, FC_SCALABLE, FcTrue);
+        font_list = FcFontList (NULL, pat, os);
 
-    g_clear_pointer (&self->font_list, FcFontSetDestroy);
+        FcPatternDestroy (pat);
+        FcObjectSetDestroy (os);
 
-    FcPatternAddBool (pat, FC_SCALABLE, FcTrue);
-    self->font_list = FcFontList (NULL, pat, os);
-
-    g_mutex_unlock (&self->font_list_mutex);
-
-    FcPatternDestroy (pat);
-    FcObjectSetDestroy (os);
-
-    if (!self->font_list)
-        return;
+        if (!font_list)
+            return;
+    }
 
     self->cancellable = g_cancellable_new ();
 
     task = g_task_new (self, self->cancellable, font_infos_loaded, NULL);
     g_task_set_return_on_cancel (task, TRUE);
-    g_task_run_in_thread (task, load_font_infos);
+
+    if (catalog != NULL) {
+        g_task_set_task_data (task, catalog, (GDestroyNotify) font_catalog_free);
+        g_task_run_in_thread (task, load_font_infos_from_catalog);
+    } else {
+        FontListJob *job = g_slice_new0 (FontListJob);
+
+        /* The task owns this snapshot of the font list; a later reload
+         * lists the fonts again rather than touching it. */
+        job->font_list = font_list;
+        job->stamp = g_steal_pointer (&stamp);
+        g_task_set_task_data (task, job, (GDestroyNotify) font_list_job_free);
+        g_task_run_in_thread (task, load_font_infos);
+    }
 }
 
 static gboolean
@@ -321,6 +883,25 @@ schedule_update_font_list (FontViewModel *self)
         g_idle_add (ensure_font_list_idle, self);
 }
 
+static gboolean
+font_list_update_timeout (gpointer user_data)
+{
+    FontViewModel *self = user_data;
+
+    self->font_list_update_id = 0;
+    ensure_font_list (self);
+
+    return FALSE;
+}
+
+static void
+fontconfig_timestamp_changed (FontViewModel *self)
+{
+    g_clear_handle_id (&self->font_list_update_id, g_source_remove);
+    self->font_list_update_id =
+        g_timeout_add (FONT_LIST_UPDATE_DELAY_MS, font_list_update_timeout, self);
+}
+
 static void
 connect_to_fontconfig_updates (FontViewModel *self)
 {
@@ -329,17 +910,14 @@ connect_to_fontconfig_updates (FontViewModel *self)
     settings = gtk_settings_get_default ();
     self->fontconfig_update_id =
         g_signal_connect_swapped (settings, "notify::gtk-fontconfig-timestamp",
-                                  G_CALLBACK (ensure_font_list), self);
+                                  G_CALLBACK (fontconfig_timestamp_changed), self);
 }
 
+
 static void
 font_view_model_init (FontViewModel *self)
 {
-    if (FT_Init_FreeType (&self->library) != FT_Err_Ok)
-        g_critical ("Can't initialize FreeType library");
-
-    g_mutex_init (&self->font_list_mutex);
-    self->model = g_list_store_new (FONT_VIEW_TYPE_MODEL_ITEM);
+    self->items = g_hash_table_new (NULL, NULL);
 
     schedule_update_font_list (self);
     connect_to_fontconfig_updates (self);
@@ -350,15 +928,27 @@ font_view_model_finalize (GObject *obj)
 {
     FontViewModel *self = FONT_VIEW_MODEL (obj);
     GtkSettings *settings;
+    GHashTableIter iter;
+    gpointer item;
 
     g_cancellable_cancel (self->cancellable);
     g_clear_object (&self->cancellable);
+    g_cancellable_cancel (self->coverage_cancellable);
+    g_clear_object (&self->coverage_cancellable);
 
-    g_clear_object (&self->model);
-    g_clear_pointer (&self->font_list, FcFontSetDestroy);
-    g_clear_pointer (&self->library, FT_Done_FreeType);
+    /* Items still held by views outlive the model. */
+    g_hash_table_iter_init (&iter, self->items);
+    while (g_hash_table_iter_next (&iter, NULL, &item))
+        g_object_weak_unref (item, item_disposed, self);
+
+    g_clear_pointer (&self->items, g_hash_table_unref);
+    g_clear_pointer (&self->store, font_store_unref);
+    g_clear_pointer (&self->search_index, font_search_index_free);
+    g_clear_pointer (&self->coverage, font_coverage_free);
+    g_clear_pointer (&self->coverage_store, font_store_unref);
 
     g_clear_handle_id (&self->font_list_idle_id, g_source_remove);
+    g_clear_handle_id (&self->font_list_update_id, g_source_remove);
 
     if (self->fontconfig_update_id != 0) {
         settings = gtk_settings_get_default ();
@@ -366,8 +956,6 @@ font_view_model_finalize (GObject *obj)
         self->fontconfig_update_id = 0;
     }
 
-    g_mutex_clear (&self->font_list_mutex);
-
     G_OBJECT_CLASS (font_view_model_parent_class)->finalize (obj);
 }
 
@@ -376,6 +964,13 @@ font_view_model_class_init (FontViewModelClass *klass)
 {
     GObjectClass *oclass = G_OBJECT_CLASS (klass);
     oclass->finalize = font_view_model_finalize;
+
+    signals[COVERAGE_CHANGED] =
+        g_signal_new ("coverage-changed",
+                      FONT_VIEW_TYPE_MODEL,
+                      G_SIGNAL_RUN_LAST,
+                      0, NULL, NULL, NULL,
+                      G_TYPE_NONE, 0);
 }
 
 FontViewModel *
@@ -387,5 +982,65 @@ font_view_model_new (void)
 GListModel *
 font_view_model_get_list_model (FontViewModel *self)
 {
-    return G_LIST_MODEL (self->model);
+    return G_LIST_MODEL (self);
+}
+
+/* Returns the positions of the items whose names contain every word of
+ * @query, in model order. */
+GArray *
+font_view_model_search (FontViewModel *self,
+                        const gchar *query)
+{
+    GArray *positions;
+    guint idx;
+
+    if (self->search_index == NULL)
+        return g_array_new (FALSE, FALSE, sizeof (guint));
+
+    /* The index was built over the current store, whose entry ids are
+     * the model positions once views know about all of it. */
+    positions = font_search_index_query (self->search_index, query);
+    for (idx = 0; idx < positions->len; idx++) {
+        if (g_array_index (positions, guint, idx) >= self->n_items) {
+            g_array_set_size (positions, idx);
+            break;
+        }
+    }
+
+    return positions;
+}
+
+/* Narrows @positions, or the whole model if NULL, to the fonts that map
+ * every character of @query. Until coverage has been computed nothing is
+ * filtered out; the model emits ::coverage-changed once it has. */
+GArray *
+font_view_model_filter_by_coverage (FontViewModel *self,
+                                    GArray *positions,
+                                    const FontCoverageQuery *query)
+{
+    GArray *covered = g_array_new (FALSE, FALSE, sizeof (guint));
+    guint idx, n_items;
+
+    n_items = positions != NULL ? positions->len : self->n_items;
+
+    for (idx = 0; idx < n_items; idx++) {
+        guint id, position = positions != NULL ? g_array_index (positions, guint, idx) : idx;
+
+        if (self->coverage != NULL) {
+            FontStore *store = font_view_model_get_entry (self, position, &id);
+            gint face = id;
+
+            /* Coverage is built in store order; entries of a newer
+             * store are matched to the one it was built for. */
+            if (store != self->coverage_store)
+                face = font_store_find_entry (self->coverage_store, store, id);
+
+            if (face < 0 || !font_coverage_covers (self->coverage, face, query))
+                continue;
+        }
+
+        g_array_append_val (covered, position);
+    }
+
+    return covered;
 }
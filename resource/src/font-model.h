@@ -27,6 +27,10 @@
 #define __FONT_VIEW_MODEL_H__
 
 #include <gtk/gtk.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include "font-coverage.h"
 
 G_BEGIN_DECLS
 
@@ -48,7 +52,15 @@ FontViewModel * font_view_model_new (void);
 
 gboolean font_view_model_has_face (FontViewModel *self,
                                    FT_Face face);
+gboolean font_view_model_has_file (FontViewModel *self,
+                                   GFile *file,
+                                   gint face_index);
 GListModel *font_view_model_get_list_model (FontViewModel *self);
+GArray *font_view_model_search (FontViewModel *self,
+                                const gchar *query);
+GArray *font_view_model_filter_by_coverage (FontViewModel *self,
+                                            GArray *positions,
+                                            const FontCoverageQuery *query);
 
 #define FONT_VIEW_TYPE_MODEL_ITEM (font_view_model_item_get_type ())
 G_DECLARE_FINAL_TYPE (FontViewModelItem, font_view_model_item,
@@ -0,0 +1,196 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-search-index.h"
+
+#include <string.h>
+
+/* Substring search over font names. Every run of one to three
+ * characters of each normalized name is indexed, so a short search
+ * term is answered by a single lookup, and a longer one only has to
+ * check the names containing its rarest trigram.
+ */
+
+#define MAX_GRAM_LENGTH 3
+
+struct _FontSearchIndex {
+    GPtrArray *texts;
+    /* Gram -> GArray of text ids, ascending. */
+    GHashTable *grams;
+};
+
+/* Folds case and compatibility forms, so "ﬁ" matches "fi" and "Sans"
+ * matches "sans". */
+static gchar *
+normalize_text (const gchar *text)
+{
+    g_autofree gchar *normalized = g_utf8_normalize (text, -1, G_NORMALIZE_ALL);
+
+    if (normalized == NULL)
+        return g_strdup ("");
+
+    return g_utf8_casefold (normalized, -1);
+}
+
+FontSearchIndex *
+font_search_index_new (void)
+{
+    FontSearchIndex *self = g_slice_new0 (FontSearchIndex);
+
+    self->texts = g_ptr_array_new_with_free_func (g_free);
+    self->grams = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         g_free, (GDestroyNotify) g_array_unref);
+
+    return self;
+}
+
+void
+font_search_index_free (FontSearchIndex *self)
+{
+    g_hash_table_unref (self->grams);
+    g_ptr_array_unref (self->texts);
+    g_slice_free (FontSearchIndex, self);
+}
+
+static void
+add_gram (FontSearchIndex *self,
+          const gchar *start,
+          const gchar *end,
+          guint32 id)
+{
+    g_autofree gchar *gram = g_strndup (start, end - start);
+    GArray *ids;
+
+    ids = g_hash_table_lookup (self->grams, gram);
+    if (ids == NULL) {
+        ids = g_array_new (FALSE, FALSE, sizeof (guint32));
+        g_hash_table_insert (self->grams, g_steal_pointer (&gram), ids);
+    }
+
+    /* Ids come in ascending order; skip repeats within one name. */
+    if (ids->len == 0 || g_array_index (ids, guint32, ids->len - 1) != id)
+        g_array_append_val (ids, id);
+}
+
+/* Adds @text and returns its id. Ids are handed out in order, starting
+ * at zero. */
+guint
+font_search_index_add (FontSearchIndex *self,
+                       const gchar *text)
+{
+    guint32 id = self->texts->len;
+    gchar *normalized = normalize_text (text);
+    const gchar *start;
+
+    g_ptr_array_add (self->texts, normalized);
+
+    for (start = normalized; *start != '\0'; start = g_utf8_next_char (start)) {
+        const gchar *end = start;
+        gint length;
+
+        for (length = 0; length < MAX_GRAM_LENGTH && *end != '\0'; length++) {
+            end = g_utf8_next_char (end);
+            add_gram (self, start, end, id);
+        }
+    }
+
+    return id;
+}
+
+/* Returns the ids of all names that may contain @term. For terms of up
+ * to three characters this is exact; for longer ones it is the rarest
+ * trigram's list, to be checked against the names. */
+static GArray *
+lookup_term_candidates (FontSearchIndex *self,
+                        const gchar *term)
+{
+    GArray *best = NULL;
+    const gchar *start;
+
+    if (g_utf8_strlen (term, -1) <= MAX_GRAM_LENGTH)
+        return g_hash_table_lookup (self->grams, term);
+
+    for (start = term; *start != '\0'; start = g_utf8_next_char (start)) {
+        g_autofree gchar *gram = NULL;
+        const gchar *end = start;
+        GArray *ids;
+        gint length;
+
+        for (length = 0; length < MAX_GRAM_LENGTH && *end != '\0'; length++)
+            end = g_utf8_next_char (end);
+
+        if (length < MAX_GRAM_LENGTH)
+            break;
+
+        gram = g_strndup (start, end - start);
+        ids = g_hash_table_lookup (self->grams, gram);
+        if (ids == NULL)
+            return NULL;
+
+        if (best == NULL || ids->len < best->len)
+            best = ids;
+    }
+
+    return best;
+}
+
+/* Returns the ids of the texts that contain every whitespace-separated
+ * term of @query, in ascending order. */
+GArray *
+font_search_index_query (FontSearchIndex *self,
+                         const gchar *query)
+{
+    g_autofree gchar *normalized = normalize_text (query);
+    g_auto(GStrv) terms = g_strsplit_set (normalized, " \t", -1);
+    GArray *results = g_array_new (FALSE, FALSE, sizeof (guint));
+    GArray *candidates = NULL;
+    gchar **term;
+    guint idx;
+
+    for (term = terms; *term != NULL; term++) {
+        GArray *ids;
+
+        if (**term == '\0')
+            continue;
+
+        ids = lookup_term_candidates (self, *term);
+        if (ids == NULL)
+            return results;
+
+        if (candidates == NULL || ids->len < candidates->len)
+            candidates = ids;
+    }
+
+    /* Nothing but whitespace matches everything. */
+    if (candidates == NULL) {
+        for (idx = 0; idx < self->texts->len; idx++)
+            g_array_append_val (results, idx);
+        return results;
+    }
+
+    for (idx = 0; idx < candidates->len; idx++) {
+        guint id = g_array_index (candidates, guint32, idx);
+        const gchar *text = g_ptr_array_index (self->texts, id);
+        gboolean matches = TRUE;
+
+        for (term = terms; *term != NULL && matches; term++)
+            matches = strstr (text, *term) != NULL;
+
+        if (matches)
+            g_array_append_val (results, id);
+    }
+
+    return results;
+}
@@ -0,0 +1,38 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_SEARCH_INDEX_H__
+#define __FONT_SEARCH_INDEX_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FontSearchIndex FontSearchIndex;
+
+FontSearchIndex *font_search_index_new (void);
+void font_search_index_free (FontSearchIndex *self);
+
+guint font_search_index_add (FontSearchIndex *self,
+                             const gchar *text);
+
+GArray *font_search_index_query (FontSearchIndex *self,
+                                 const gchar *query);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontSearchIndex, font_search_index_free)
+
+G_END_DECLS
+
+#endif /* __FONT_SEARCH_INDEX_H__ */
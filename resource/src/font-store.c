@@ -0,0 +1,478 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-store.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The installed fonts, in as little memory as possible: one array per
+ * field, indexed by entry, and every string once in a shared arena,
+ * addressed by offset. Paths are split into a directory, kept once in
+ * a table since a few directories hold thousands of fonts, and a file
+ * name.
+ *
+ * A store is built once, usually in a loading thread, and never
+ * changes after that, so it is shared between threads freely. It is
+ * indexed when built, by path and face index and by font name, so
+ * checking an opened file against the installed fonts takes constant
+ * time however many there are.
+ */
+
+struct _FontStore {
+    gint ref_count;
+
+    guint n_entries;
+    guint32 *font_names;
+    guint32 *collation_keys;
+    guint32 *dirs;
+    guint32 *basenames;
+    gint32 *face_indexes;
+
+    /* Arena offsets of the directories, with their trailing slash. */
+    guint32 *dir_offsets;
+    guint n_dirs;
+
+    /* Open-addressed tables of entry id + 1, or 0 for an empty slot,
+     * by path and face index and by font name; the name table keeps
+     * the first entry of each name. A power of two at least twice the
+     * number of entries, so probes stay short. */
+    guint32 *path_slots;
+    guint32 *name_slots;
+    guint n_slots;
+
+    gchar *strings;
+};
+
+struct _FontStoreBuilder {
+    GArray *font_names;
+    GArray *collation_keys;
+    GArray *dirs;
+    GArray *basenames;
+    GArray *face_indexes;
+    GArray *dir_offsets;
+
+    GString *strings;
+    /* String -> arena offset, and directory offset -> table index. */
+    GHashTable *interned;
+    GHashTable *dir_ids;
+};
+
+FontStoreBuilder *
+font_store_builder_new (void)
+{
+    FontStoreBuilder *builder = g_slice_new0 (FontStoreBuilder);
+
+    builder->font_names = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->collation_keys = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->dirs = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->basenames = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->face_indexes = g_array_new (FALSE, FALSE, sizeof (gint32));
+    builder->dir_offsets = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder->strings = g_string_new (NULL);
+    builder->interned = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    builder->dir_ids = g_hash_table_new (NULL, NULL);
+
+    return builder;
+}
+
+void
+font_store_builder_free (FontStoreBuilder *builder)
+{
+    g_clear_pointer (&builder->font_names, g_array_unref);
+    g_clear_pointer (&builder->collation_keys, g_array_unref);
+    g_clear_pointer (&builder->dirs, g_array_unref);
+    g_clear_pointer (&builder->basenames, g_array_unref);
+    g_clear_pointer (&builder->face_indexes, g_array_unref);
+    g_clear_pointer (&builder->dir_offsets, g_array_unref);
+    if (builder->strings != NULL)
+        g_string_free (builder->strings, TRUE);
+    g_hash_table_unref (builder->interned);
+    g_hash_table_unref (builder->dir_ids);
+    g_slice_free (FontStoreBuilder, builder);
+}
+
+static guint32
+builder_intern (FontStoreBuilder *builder,
+                const gchar *str,
+                gsize length)
+{
+    g_autofree gchar *key = g_strndup (str, length);
+    gpointer offset;
+
+    if (g_hash_table_lookup_extended (builder->interned, key, NULL, &offset))
+        return GPOINTER_TO_UINT (offset);
+
+    offset = GUINT_TO_POINTER (builder->strings->len);
+    g_string_append_len (builder->strings, key, length + 1);
+    g_hash_table_insert (builder->interned, g_steal_pointer (&key), offset);
+
+    return GPOINTER_TO_UINT (offset);
+}
+
+static guint32
+builder_intern_dir (FontStoreBuilder *builder,
+                    const gchar *dir,
+                    gsize length)
+{
+    guint32 offset = builder_intern (builder, dir, length);
+    gpointer id;
+
+    if (g_hash_table_lookup_extended (builder->dir_ids, GUINT_TO_POINTER (offset), NULL, &id))
+        return GPOINTER_TO_UINT (id);
+
+    id = GUINT_TO_POINTER (builder->dir_offsets->len);
+    g_array_append_val (builder->dir_offsets, offset);
+    g_hash_table_insert (builder->dir_ids, GUINT_TO_POINTER (offset), id);
+
+    return GPOINTER_TO_UINT (id);
+}
+
+/* Entries keep the order they are added in. */
+void
+font_store_builder_add (FontStoreBuilder *builder,
+                        const gchar *path,
+                        gint face_index,
+                        const gchar *font_name,
+                        const gchar *collation_key)
+{
+    const gchar *basename = strrchr (path, '/');
+    guint32 offset;
+    gint32 index = face_index;
+
+    basename = basename != NULL ? basename + 1 : path;
+
+    offset = builder_intern (builder, font_name, strlen (font_name));
+    g_array_append_val (builder->font_names, offset);
+    offset = builder_intern (builder, collation_key, strlen (collation_key));
+    g_array_append_val (builder->collation_keys, offset);
+    offset = builder_intern_dir (builder, path, basename - path);
+    g_array_append_val (builder->dirs, offset);
+    offset = builder_intern (builder, basename, strlen (basename));
+    g_array_append_val (builder->basenames, offset);
+    g_array_append_val (builder->face_indexes, index);
+}
+
+/* Takes the data of @array, trimmed to its length. */
+static gpointer
+steal_array (GArray **array)
+{
+    gsize size = (*array)->len * g_array_get_element_size (*array);
+
+    return g_realloc (g_array_free (g_steal_pointer (array), FALSE), size);
+}
+
+static const gchar *
+font_store_get_dir (FontStore *self,
+                    guint id)
+{
+    return self->strings + self->dir_offsets[self->dirs[id]];
+}
+
+#define HASH_INIT 2166136261u
+#define HASH_PRIME 16777619u
+
+/* FNV-1a, continued from @hash. */
+static guint32
+hash_string (guint32 hash,
+             const gchar *str)
+{
+    for (; *str != '\0'; str++) {
+        hash ^= (guchar) *str;
+        hash *= HASH_PRIME;
+    }
+
+    return hash;
+}
+
+static guint32
+hash_face (guint32 path_hash,
+           gint face_index)
+{
+    return (path_hash ^ (guint32) face_index) * HASH_PRIME;
+}
+
+static void
+font_store_build_index (FontStore *self)
+{
+    guint mask, id;
+
+    self->n_slots = 16;
+    while (self->n_slots < 2 * self->n_entries)
+        self->n_slots *= 2;
+    mask = self->n_slots - 1;
+
+    self->path_slots = g_new0 (guint32, self->n_slots);
+    self->name_slots = g_new0 (guint32, self->n_slots);
+
+    for (id = 0; id < self->n_entries; id++) {
+        guint32 hash, slot;
+
+        /* The directory ends in a slash, so this hashes the path. */
+        hash = hash_string (hash_string (HASH_INIT, font_store_get_dir (self, id)),
+                            self->strings + self->basenames[id]);
+        slot = hash_face (hash, self->face_indexes[id]) & mask;
+        while (self->path_slots[slot] != 0)
+            slot = (slot + 1) & mask;
+        self->path_slots[slot] = id + 1;
+
+        /* Names are interned, so equal names have equal offsets. */
+        slot = hash_string (HASH_INIT, self->strings + self->font_names[id]) & mask;
+        while (self->name_slots[slot] != 0 &&
+               self->font_names[self->name_slots[slot] - 1] != self->font_names[id])
+            slot = (slot + 1) & mask;
+        if (self->name_slots[slot] == 0)
+            self->name_slots[slot] = id + 1;
+    }
+}
+
+/* Turns the builder into a store, and frees it. */
+FontStore *
+font_store_builder_end (FontStoreBuilder *builder)
+{
+    FontStore *self = g_slice_new0 (FontStore);
+    gsize strings_length = builder->strings->len;
+
+    self->ref_count = 1;
+    self->n_entries = builder->font_names->len;
+    self->n_dirs = builder->dir_offsets->len;
+
+    self->font_names = steal_array (&builder->font_names);
+    self->collation_keys = steal_array (&builder->collation_keys);
+    self->dirs = steal_array (&builder->dirs);
+    self->basenames = steal_array (&builder->basenames);
+    self->face_indexes = steal_array (&builder->face_indexes);
+    self->dir_offsets = steal_array (&builder->dir_offsets);
+    self->strings = g_realloc (g_string_free (g_steal_pointer (&builder->strings), FALSE),
+                               strings_length);
+
+    font_store_builder_free (builder);
+
+    font_store_build_index (self);
+
+    return self;
+}
+
+FontStore *
+font_store_ref (FontStore *self)
+{
+    g_atomic_int_inc (&self->ref_count);
+    return self;
+}
+
+void
+font_store_unref (FontStore *self)
+{
+    if (!g_atomic_int_dec_and_test (&self->ref_count))
+        return;
+
+    g_free (self->font_names);
+    g_free (self->collation_keys);
+    g_free (self->dirs);
+    g_free (self->basenames);
+    g_free (self->face_indexes);
+    g_free (self->dir_offsets);
+    g_free (self->path_slots);
+    g_free (self->name_slots);
+    g_free (self->strings);
+    g_slice_free (FontStore, self);
+}
+
+guint
+font_store_get_n_entries (FontStore *self)
+{
+    return self->n_entries;
+}
+
+const gchar *
+font_store_get_font_name (FontStore *self,
+                          guint id)
+{
+    return self->strings + self->font_names[id];
+}
+
+const gchar *
+font_store_get_collation_key (FontStore *self,
+                              guint id)
+{
+    return self->strings + self->collation_keys[id];
+}
+
+gint
+font_store_get_face_index (FontStore *self,
+                           guint id)
+{
+    return self->face_indexes[id];
+}
+
+gchar *
+font_store_dup_path (FontStore *self,
+                     guint id)
+{
+    return g_strconcat (font_store_get_dir (self, id),
+                        self->strings + self->basenames[id], NULL);
+}
+
+/* Whether the entries are the same face under the same name. */
+gboolean
+font_store_entry_equal (FontStore *a,
+                        guint id_a,
+                        FontStore *b,
+                        guint id_b)
+{
+    return a->face_indexes[id_a] == b->face_indexes[id_b] &&
+        strcmp (a->strings + a->basenames[id_a], b->strings + b->basenames[id_b]) == 0 &&
+        strcmp (font_store_get_dir (a, id_a), font_store_get_dir (b, id_b)) == 0 &&
+        strcmp (a->strings + a->font_names[id_a], b->strings + b->font_names[id_b]) == 0;
+}
+
+/* Compares two paths given as directory and file name, as if joined. */
+static gint
+compare_paths (const gchar *dir_a,
+               const gchar *basename_a,
+               const gchar *dir_b,
+               const gchar *basename_b)
+{
+    const gchar *a = dir_a, *b = dir_b;
+
+    for (;;) {
+        if (*a == '\0' && basename_a != NULL) {
+            a = basename_a;
+            basename_a = NULL;
+            continue;
+        }
+        if (*b == '\0' && basename_b != NULL) {
+            b = basename_b;
+            basename_b = NULL;
+            continue;
+        }
+        if (*a != *b || *a == '\0')
+            return (guchar) *a - (guchar) *b;
+
+        a++;
+        b++;
+    }
+}
+
+/* Orders entries the way the font list is sorted: by collation key,
+ * then path, then face index. */
+gint
+font_store_entry_compare (FontStore *a,
+                          guint id_a,
+                          FontStore *b,
+                          guint id_b)
+{
+    gint result;
+
+    result = strcmp (a->strings + a->collation_keys[id_a], b->strings + b->collation_keys[id_b]);
+    if (result == 0)
+        result = compare_paths (font_store_get_dir (a, id_a), a->strings + a->basenames[id_a],
+                                font_store_get_dir (b, id_b), b->strings + b->basenames[id_b]);
+    if (result == 0)
+        result = a->face_indexes[id_a] - b->face_indexes[id_b];
+
+    return result;
+}
+
+/* Resolves symbolic links and dot segments in @path, the form paths
+ * are stored and looked up in, so that a font reached through a link
+ * matches the installed one. Falls back to @path itself when it can't
+ * be resolved. */
+gchar *
+font_store_canonicalize_path (const gchar *path)
+{
+    gchar resolved[PATH_MAX];
+
+    if (realpath (path, resolved) == NULL)
+        return g_strdup (path);
+
+    return g_strdup (resolved);
+}
+
+/* Returns the entry for face @face_index of @path, or -1. */
+gint
+font_store_find (FontStore *self,
+                 const gchar *path,
+                 gint face_index)
+{
+    const gchar *basename = strrchr (path, '/');
+    guint mask = self->n_slots - 1;
+    gsize dir_length;
+    guint32 slot;
+
+    basename = basename != NULL ? basename + 1 : path;
+    dir_length = basename - path;
+
+    slot = hash_face (hash_string (HASH_INIT, path), face_index) & mask;
+    for (; self->path_slots[slot] != 0; slot = (slot + 1) & mask) {
+        guint id = self->path_slots[slot] - 1;
+        const gchar *dir;
+
+        if (self->face_indexes[id] != face_index ||
+            strcmp (self->strings + self->basenames[id], basename) != 0)
+            continue;
+
+        dir = font_store_get_dir (self, id);
+        if (strlen (dir) == dir_length && strncmp (dir, path, dir_length) == 0)
+            return id;
+    }
+
+    return -1;
+}
+
+/* Returns the entry for the face of entry @other_id of @other, or -1.
+ * Unlike font_store_find(), this never joins the path. */
+gint
+font_store_find_entry (FontStore *self,
+                       FontStore *other,
+                       guint other_id)
+{
+    const gchar *dir = font_store_get_dir (other, other_id);
+    const gchar *basename = other->strings + other->basenames[other_id];
+    gint face_index = other->face_indexes[other_id];
+    guint mask = self->n_slots - 1;
+    guint32 slot;
+
+    slot = hash_face (hash_string (hash_string (HASH_INIT, dir), basename), face_index) & mask;
+    for (; self->path_slots[slot] != 0; slot = (slot + 1) & mask) {
+        guint id = self->path_slots[slot] - 1;
+
+        if (self->face_indexes[id] == face_index &&
+            strcmp (self->strings + self->basenames[id], basename) == 0 &&
+            strcmp (font_store_get_dir (self, id), dir) == 0)
+            return id;
+    }
+
+    return -1;
+}
+
+gboolean
+font_store_has_font_name (FontStore *self,
+                          const gchar *font_name)
+{
+    guint mask = self->n_slots - 1;
+    guint32 slot;
+
+    slot = hash_string (HASH_INIT, font_name) & mask;
+    for (; self->name_slots[slot] != 0; slot = (slot + 1) & mask) {
+        guint id = self->name_slots[slot] - 1;
+
+        if (strcmp (self->strings + self->font_names[id], font_name) == 0)
+            return TRUE;
+    }
+
+    return FALSE;
+}
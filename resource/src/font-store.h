@@ -0,0 +1,72 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_STORE_H__
+#define __FONT_STORE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _FontStore FontStore;
+typedef struct _FontStoreBuilder FontStoreBuilder;
+
+FontStoreBuilder *font_store_builder_new (void);
+void font_store_builder_free (FontStoreBuilder *builder);
+
+void font_store_builder_add (FontStoreBuilder *builder,
+                             const gchar *path,
+                             gint face_index,
+                             const gchar *font_name,
+                             const gchar *collation_key);
+FontStore *font_store_builder_end (FontStoreBuilder *builder);
+
+FontStore *font_store_ref (FontStore *self);
+void font_store_unref (FontStore *self);
+
+guint font_store_get_n_entries (FontStore *self);
+const gchar *font_store_get_font_name (FontStore *self,
+                                       guint id);
+const gchar *font_store_get_collation_key (FontStore *self,
+                                           guint id);
+gint font_store_get_face_index (FontStore *self,
+                                guint id);
+gchar *font_store_dup_path (FontStore *self,
+                            guint id);
+
+gboolean font_store_entry_equal (FontStore *a,
+                                 guint id_a,
+                                 FontStore *b,
+                                 guint id_b);
+gint font_store_entry_compare (FontStore *a,
+                               guint id_a,
+                               FontStore *b,
+                               guint id_b);
+gchar *font_store_canonicalize_path (const gchar *path);
+gint font_store_find (FontStore *self,
+                      const gchar *path,
+                      gint face_index);
+gint font_store_find_entry (FontStore *self,
+                            FontStore *other,
+                            guint other_id);
+gboolean font_store_has_font_name (FontStore *self,
+                                   const gchar *font_name);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontStoreBuilder, font_store_builder_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FontStore, font_store_unref)
+
+G_END_DECLS
+
+#endif /* __FONT_STORE_H__ */
@@ -0,0 +1,881 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-thumbnail.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+/* Font names rendered in the font itself, for the overview.
+ *
+ * Thumbnails are rasterized by a small pool of threads, each with its
+ * own FreeType library, straight into A8 surfaces that the view paints
+ * in its foreground color. Queued requests run by priority, so the
+ * rows on screen come before the ones just outside it, and a request
+ * cancelled while queued is dropped without opening the font.
+ *
+ * Thumbnails are identified by a 64-bit hash of everything the raster
+ * depends on, the file's modification time included. Finished ones are
+ * kept on the main thread by it, most recently used first, within a
+ * byte budget. They are also saved to one packed file in the cache
+ * directory, which render threads look in before opening the font, so
+ * later runs show unchanged fonts without FreeType. The file is a
+ * header, entries sorted by that hash, and the rasters themselves, with
+ * the row stride cairo uses, so surfaces are created right on top of
+ * the mapping.
+ */
+
+#define MAX_RENDER_THREADS 4
+#define DEFAULT_THUMBNAIL_CACHE_MB 16
+/* Glyphs shown for faces that can't render their own name. */
+#define SPECIMEN_LENGTH 6
+
+#define DISK_CACHE_MAGIC "SMTTHUMB"
+#define DISK_CACHE_VERSION 1
+#define DISK_CACHE_FILE "thumbnails.bin"
+#define DISK_CACHE_MAX_MB 64
+/* New thumbnails come in bursts as the overview scrolls. */
+#define DISK_CACHE_FLUSH_DELAY_S 2
+
+typedef struct {
+    gchar magic[8];
+    guint32 version;
+    guint32 n_entries;
+} DiskCacheHeader;
+
+typedef struct {
+    guint64 key;
+    /* From the start of the raster block. */
+    guint64 offset;
+    guint32 width;
+    guint32 height;
+} DiskCacheEntry;
+
+typedef struct {
+    guint64 key;
+    const guchar *data;
+    guint32 width;
+    guint32 height;
+} DiskCacheRaster;
+
+typedef struct {
+    gchar *path;
+    gint face_index;
+    gchar *text;
+    gint size;
+    gint scale;
+    gint max_width;
+    guint64 sequence;
+
+    /* Key into both caches, or 0 if the file can't be found. */
+    guint64 key;
+    gboolean rendered;
+} ThumbnailJob;
+
+typedef struct {
+    guint64 key;
+    cairo_surface_t *surface;
+    gsize cost;
+    GList link;
+} CachedThumbnail;
+
+static GHashTable *thumbnail_cache = NULL;
+static GQueue thumbnail_cache_lru = G_QUEUE_INIT;
+static gsize thumbnail_cache_size = 0;
+static guint64 next_sequence = 0;
+
+/* The mapped disk cache, shared with the render threads, which take a
+ * reference to read it. Replaced whenever new thumbnails are saved. */
+G_LOCK_DEFINE_STATIC (disk_cache);
+static GMappedFile *disk_cache_file = NULL;
+static gboolean disk_cache_opened = FALSE;
+
+/* Surfaces rendered but not saved yet, each carrying its raster as
+ * user data; main thread only. */
+static GPtrArray *disk_cache_pending = NULL;
+static guint disk_cache_flush_id = 0;
+static gboolean disk_cache_flushing = FALSE;
+
+static cairo_user_data_key_t mapping_key;
+static cairo_user_data_key_t raster_key;
+
+static void
+free_thread_library (gpointer data)
+{
+    FT_Done_FreeType (data);
+}
+
+static GPrivate thread_library = G_PRIVATE_INIT (free_thread_library);
+
+/* A FreeType library must not be used by two threads at once, so each
+ * render thread has its own. */
+static FT_Library
+get_thread_library (void)
+{
+    FT_Library library = g_private_get (&thread_library);
+
+    if (library == NULL) {
+        if (FT_Init_FreeType (&library) != FT_Err_Ok)
+            return NULL;
+
+        g_private_set (&thread_library, library);
+    }
+
+    return library;
+}
+
+static void
+thumbnail_job_free (ThumbnailJob *job)
+{
+    g_free (job->path);
+    g_free (job->text);
+    g_slice_free (ThumbnailJob, job);
+}
+
+/* FNV-1a, over the file's identity and everything the raster depends
+ * on. Returns 0, which no thumbnail has, if the file can't be found. */
+static guint64
+thumbnail_key (const gchar *path,
+               gint face_index,
+               const gchar *text,
+               gint size,
+               gint scale,
+               gint max_width)
+{
+    g_autofree gchar *description = NULL;
+    guint64 hash = G_GUINT64_CONSTANT (0xcbf29ce484222325);
+    const guchar *p;
+    GStatBuf st;
+
+    if (g_stat (path, &st) != 0)
+        return 0;
+
+    description = g_strdup_printf ("%s\n%d\n%" G_GINT64_FORMAT "\n%d\n%d\n%d\n%s",
+                                   path, face_index, (gint64) st.st_mtime, size,
+                                   scale, max_width, text);
+
+    for (p = (const guchar *) description; *p != '\0'; p++) {
+        hash ^= *p;
+        hash *= G_GUINT64_CONSTANT (0x100000001b3);
+    }
+
+    return hash != 0 ? hash : 1;
+}
+
+static gsize
+thumbnail_cache_get_budget (void)
+{
+    static gsize budget = 0;
+
+    if (g_once_init_enter (&budget)) {
+        const gchar *env = g_getenv ("SHOWMYTEXT_THUMBNAIL_CACHE_MB");
+        guint64 mb = DEFAULT_THUMBNAIL_CACHE_MB;
+
+        if (env != NULL)
+            mb = g_ascii_strtoull (env, NULL, 10);
+
+        g_once_init_leave (&budget, MAX (mb, 1) * 1024 * 1024);
+    }
+
+    return budget;
+}
+
+static void
+cached_thumbnail_free (CachedThumbnail *cached)
+{
+    cairo_surface_destroy (cached->surface);
+    g_slice_free (CachedThumbnail, cached);
+}
+
+static void
+thumbnail_cache_insert (guint64 key,
+                        cairo_surface_t *surface)
+{
+    CachedThumbnail *cached;
+    gsize budget = thumbnail_cache_get_budget ();
+
+    if (thumbnail_cache == NULL)
+        thumbnail_cache = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL,
+                                                 (GDestroyNotify) cached_thumbnail_free);
+
+    if (g_hash_table_contains (thumbnail_cache, &key))
+        return;
+
+    cached = g_slice_new0 (CachedThumbnail);
+    cached->key = key;
+    cached->surface = cairo_surface_reference (surface);
+    cached->cost = cairo_image_surface_get_stride (surface) *
+        cairo_image_surface_get_height (surface);
+    cached->link.data = cached;
+
+    g_hash_table_insert (thumbnail_cache, &cached->key, cached);
+    g_queue_push_head_link (&thumbnail_cache_lru, &cached->link);
+    thumbnail_cache_size += cached->cost;
+
+    while (thumbnail_cache_size > budget && thumbnail_cache_lru.length > 1) {
+        CachedThumbnail *oldest = g_queue_pop_tail_link (&thumbnail_cache_lru)->data;
+
+        thumbnail_cache_size -= oldest->cost;
+        g_hash_table_remove (thumbnail_cache, &oldest->key);
+    }
+}
+
+/* Returns the thumbnail font_thumbnail_render_async() would render
+ * for the same arguments if it has rendered it before, from the same
+ * version of the file. The surface belongs to the cache; reference it
+ * to keep it. Main thread only. */
+cairo_surface_t *
+font_thumbnail_lookup (GFile *file,
+                       gint face_index,
+                       const gchar *text,
+                       gint size,
+                       gint scale,
+                       gint max_width)
+{
+    const gchar *path = g_file_peek_path (file);
+    CachedThumbnail *cached;
+    guint64 key;
+
+    if (thumbnail_cache == NULL || path == NULL)
+        return NULL;
+
+    /* Costs a stat, so that a font replaced in place doesn't keep
+     * showing its old thumbnail. */
+    key = thumbnail_key (path, face_index, text, size, scale, max_width);
+    if (key == 0)
+        return NULL;
+
+    cached = g_hash_table_lookup (thumbnail_cache, &key);
+    if (cached == NULL)
+        return NULL;
+
+    g_queue_unlink (&thumbnail_cache_lru, &cached->link);
+    g_queue_push_head_link (&thumbnail_cache_lru, &cached->link);
+
+    return cached->surface;
+}
+
+/* The glyphs of @text, or of the first few characters the face maps
+ * when it lacks any of them, as symbol fonts do. */
+static GArray *
+get_glyphs (FT_Face face,
+            const gchar *text)
+{
+    GArray *glyphs = g_array_new (FALSE, FALSE, sizeof (FT_UInt));
+    const gchar *p;
+    FT_ULong charcode;
+    FT_UInt glyph;
+
+    for (p = text; *p != '\0'; p = g_utf8_next_char (p)) {
+        gunichar ch = g_utf8_get_char (p);
+
+        glyph = FT_Get_Char_Index (face, ch);
+        if (glyph == 0 && g_unichar_isspace (ch))
+            continue;
+
+        if (glyph == 0) {
+            g_array_set_size (glyphs, 0);
+            break;
+        }
+
+        g_array_append_val (glyphs, glyph);
+    }
+
+    if (glyphs->len > 0)
+        return glyphs;
+
+    for (charcode = FT_Get_First_Char (face, &glyph);
+         glyph != 0 && glyphs->len < SPECIMEN_LENGTH;
+         charcode = FT_Get_Next_Char (face, charcode, &glyph)) {
+        /* Skip controls and spaces, also in the symbol area. */
+        if ((charcode & 0xff) <= 0x20)
+            continue;
+
+        g_array_append_val (glyphs, glyph);
+    }
+
+    return glyphs;
+}
+
+static void
+blit_glyph (FT_GlyphSlot slot,
+            gint x,
+            gint y,
+            guchar *data,
+            gint width,
+            gint height,
+            gint stride)
+{
+    FT_Bitmap *bitmap = &slot->bitmap;
+    guint row, col;
+
+    if (bitmap->pixel_mode != FT_PIXEL_MODE_GRAY)
+        return;
+
+    x += slot->bitmap_left;
+    y -= slot->bitmap_top;
+
+    for (row = 0; row < bitmap->rows; row++) {
+        const guchar *src = bitmap->buffer + row * bitmap->pitch;
+        gint dst_y = y + (gint) row;
+        guchar *dst;
+
+        if (dst_y < 0 || dst_y >= height)
+            continue;
+
+        dst = data + dst_y * stride;
+        for (col = 0; col < bitmap->width; col++) {
+            gint dst_x = x + (gint) col;
+
+            if (dst_x >= 0 && dst_x < width)
+                dst[dst_x] = MIN (255, dst[dst_x] + src[col]);
+        }
+    }
+}
+
+/* Lays @job's text out on one line, without shaping, dropping the
+ * glyphs past the maximum width, and renders it. */
+static cairo_surface_t *
+render_thumbnail (FT_Library library,
+                  ThumbnailJob *job,
+                  GError **error)
+{
+    g_autoptr(GArray) glyphs = NULL;
+    g_autofree FT_Pos *positions = NULL;
+    cairo_surface_t *surface = NULL;
+    FT_Face face;
+    FT_Error ft_error;
+    FT_Pos pen = 0, max_pen;
+    gint width, height, baseline, stride;
+    guchar *data;
+    guint idx, n_glyphs;
+
+    ft_error = FT_New_Face (library, job->path, job->face_index, &face);
+    if (ft_error != FT_Err_Ok) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to load %s (FreeType error %d)", job->path, ft_error);
+        return NULL;
+    }
+
+    ft_error = FT_Set_Pixel_Sizes (face, 0, job->size * job->scale);
+    if (ft_error != FT_Err_Ok) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to scale %s (FreeType error %d)", job->path, ft_error);
+        goto out;
+    }
+
+    glyphs = get_glyphs (face, job->text);
+    positions = g_new0 (FT_Pos, glyphs->len);
+    max_pen = (FT_Pos) job->max_width * job->scale * 64;
+
+    for (n_glyphs = 0; n_glyphs < glyphs->len; n_glyphs++) {
+        FT_UInt glyph = g_array_index (glyphs, FT_UInt, n_glyphs);
+        FT_Vector delta;
+
+        if (n_glyphs > 0 && FT_HAS_KERNING (face) &&
+            FT_Get_Kerning (face, g_array_index (glyphs, FT_UInt, n_glyphs - 1), glyph,
+                            FT_KERNING_DEFAULT, &delta) == FT_Err_Ok)
+            pen += delta.x;
+
+        positions[n_glyphs] = pen;
+
+        if (FT_Load_Glyph (face, glyph, FT_LOAD_DEFAULT) != FT_Err_Ok)
+            continue;
+
+        if (pen + face->glyph->advance.x > max_pen)
+            break;
+
+        pen += face->glyph->advance.x;
+    }
+
+    width = MAX (1, (pen + 63) >> 6);
+    baseline = (face->size->metrics.ascender + 63) >> 6;
+    height = MAX (1, baseline + ((-face->size->metrics.descender + 63) >> 6));
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+    if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                     "Unable to create a %dx%d thumbnail", width, height);
+        g_clear_pointer (&surface, cairo_surface_destroy);
+        goto out;
+    }
+
+    cairo_surface_flush (surface);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+
+    for (idx = 0; idx < n_glyphs; idx++) {
+        if (FT_Load_Glyph (face, g_array_index (glyphs, FT_UInt, idx), FT_LOAD_RENDER) != FT_Err_Ok)
+            continue;
+
+        blit_glyph (face->glyph, (positions[idx] + 32) >> 6, baseline,
+                    data, width, height, stride);
+    }
+
+    cairo_surface_mark_dirty (surface);
+    cairo_surface_set_device_scale (surface, job->scale, job->scale);
+
+ out:
+    FT_Done_Face (face);
+    return surface;
+}
+
+static gchar *
+get_disk_cache_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "showmytext",
+                             DISK_CACHE_FILE, NULL);
+}
+
+static GMappedFile *
+disk_cache_open (void)
+{
+    g_autofree gchar *path = get_disk_cache_path ();
+    g_autoptr(GMappedFile) mapped_file = NULL;
+    const DiskCacheHeader *header;
+    gsize length;
+
+    mapped_file = g_mapped_file_new (path, FALSE, NULL);
+    if (mapped_file == NULL)
+        return NULL;
+
+    length = g_mapped_file_get_length (mapped_file);
+    if (length < sizeof (DiskCacheHeader))
+        return NULL;
+
+    header = (const DiskCacheHeader *) g_mapped_file_get_contents (mapped_file);
+    if (memcmp (header->magic, DISK_CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+        header->version != DISK_CACHE_VERSION ||
+        header->n_entries > (length - sizeof (DiskCacheHeader)) / sizeof (DiskCacheEntry))
+        return NULL;
+
+    return g_steal_pointer (&mapped_file);
+}
+
+static GMappedFile *
+disk_cache_ref_file (void)
+{
+    GMappedFile *mapped_file = NULL;
+
+    G_LOCK (disk_cache);
+
+    if (!disk_cache_opened) {
+        disk_cache_file = disk_cache_open ();
+        disk_cache_opened = TRUE;
+    }
+
+    if (disk_cache_file != NULL)
+        mapped_file = g_mapped_file_ref (disk_cache_file);
+
+    G_UNLOCK (disk_cache);
+
+    return mapped_file;
+}
+
+/* Finds @key in @mapped_file, checking the entry stays inside it. */
+static gboolean
+disk_cache_find (GMappedFile *mapped_file,
+                 guint64 key,
+                 DiskCacheRaster *raster)
+{
+    const gchar *contents = g_mapped_file_get_contents (mapped_file);
+    gsize length = g_mapped_file_get_length (mapped_file);
+    const DiskCacheHeader *header = (const DiskCacheHeader *) contents;
+    const DiskCacheEntry *entries = (const DiskCacheEntry *) (header + 1);
+    const guchar *rasters = (const guchar *) (entries + header->n_entries);
+    gsize rasters_length = contents + length - (const gchar *) rasters;
+    guint low = 0, high = header->n_entries;
+
+    while (low < high) {
+        guint mid = low + (high - low) / 2;
+        const DiskCacheEntry *entry = &entries[mid];
+        gint stride;
+
+        if (entry->key < key) {
+            low = mid + 1;
+            continue;
+        }
+
+        if (entry->key > key) {
+            high = mid;
+            continue;
+        }
+
+        stride = cairo_format_stride_for_width (CAIRO_FORMAT_A8, entry->width);
+        if (entry->width == 0 || entry->height == 0 || stride <= 0 ||
+            entry->offset > rasters_length ||
+            (guint64) stride * entry->height > rasters_length - entry->offset)
+            return FALSE;
+
+        raster->key = key;
+        raster->data = rasters + entry->offset;
+        raster->width = entry->width;
+        raster->height = entry->height;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+/* Returns the saved thumbnail for @job, wrapping the mapping itself. */
+static cairo_surface_t *
+disk_cache_lookup (ThumbnailJob *job)
+{
+    g_autoptr(GMappedFile) mapped_file = NULL;
+    cairo_surface_t *surface;
+    DiskCacheRaster raster;
+
+    if (job->key == 0)
+        return NULL;
+
+    mapped_file = disk_cache_ref_file ();
+    if (mapped_file == NULL || !disk_cache_find (mapped_file, job->key, &raster))
+        return NULL;
+
+    /* Only ever read: it is a mask. */
+    surface = cairo_image_surface_create_for_data ((guchar *) raster.data, CAIRO_FORMAT_A8,
+                                                   raster.width, raster.height,
+                                                   cairo_format_stride_for_width (CAIRO_FORMAT_A8,
+                                                                                  raster.width));
+    cairo_surface_set_user_data (surface, &mapping_key, g_steal_pointer (&mapped_file),
+                                 (cairo_destroy_func_t) g_mapped_file_unref);
+    cairo_surface_set_device_scale (surface, job->scale, job->scale);
+
+    return surface;
+}
+
+static void
+disk_cache_raster_free (DiskCacheRaster *raster)
+{
+    g_slice_free (DiskCacheRaster, raster);
+}
+
+static gint
+compare_rasters (gconstpointer a,
+                 gconstpointer b)
+{
+    const DiskCacheRaster *raster_a = *(const DiskCacheRaster **) a;
+    const DiskCacheRaster *raster_b = *(const DiskCacheRaster **) b;
+
+    if (raster_a->key == raster_b->key)
+        return 0;
+
+    return raster_a->key < raster_b->key ? -1 : 1;
+}
+
+/* Writes the new thumbnails and as many of the saved ones as fit in the
+ * budget to a new file, then maps that in place of the old one. */
+static void
+disk_cache_write (GTask *task,
+                  gpointer source_object,
+                  gpointer user_data,
+                  GCancellable *cancellable)
+{
+    GPtrArray *surfaces = user_data;
+    g_autoptr(GMappedFile) old_file = disk_cache_ref_file ();
+    g_autoptr(GPtrArray) rasters = g_ptr_array_new_with_free_func ((GDestroyNotify) disk_cache_raster_free);
+    g_autoptr(GHashTable) keys = g_hash_table_new (g_int64_hash, g_int64_equal);
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    g_autofree gchar *path = get_disk_cache_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr(GError) error = NULL;
+    DiskCacheHeader header = { { 0, } };
+    GMappedFile *new_file;
+    gsize budget = (gsize) DISK_CACHE_MAX_MB * 1024 * 1024, size = 0;
+    guint64 offset = 0;
+    guint idx;
+
+    for (idx = 0; idx < surfaces->len; idx++) {
+        cairo_surface_t *surface = g_ptr_array_index (surfaces, idx);
+        DiskCacheRaster *raster = cairo_surface_get_user_data (surface, &raster_key);
+
+        if (g_hash_table_contains (keys, &raster->key))
+            continue;
+
+        size += cairo_image_surface_get_stride (surface) * raster->height;
+        g_ptr_array_add (rasters, g_slice_dup (DiskCacheRaster, raster));
+        g_hash_table_add (keys, &raster->key);
+    }
+
+    if (old_file != NULL) {
+        const DiskCacheHeader *old_header =
+            (const DiskCacheHeader *) g_mapped_file_get_contents (old_file);
+        const DiskCacheEntry *old_entries = (const DiskCacheEntry *) (old_header + 1);
+
+        for (idx = 0; idx < old_header->n_entries && size < budget; idx++) {
+            DiskCacheRaster raster;
+
+            if (g_hash_table_contains (keys, &old_entries[idx].key) ||
+                !disk_cache_find (old_file, old_entries[idx].key, &raster))
+                continue;
+
+            size += cairo_format_stride_for_width (CAIRO_FORMAT_A8, raster.width) * raster.height;
+            g_ptr_array_add (rasters, g_slice_dup (DiskCacheRaster, &raster));
+        }
+    }
+
+    g_ptr_array_sort (rasters, compare_rasters);
+
+    memcpy (header.magic, DISK_CACHE_MAGIC, sizeof (header.magic));
+    header.version = DISK_CACHE_VERSION;
+    header.n_entries = rasters->len;
+    g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+
+    for (idx = 0; idx < rasters->len; idx++) {
+        DiskCacheRaster *raster = g_ptr_array_index (rasters, idx);
+        DiskCacheEntry entry;
+
+        entry.key = raster->key;
+        entry.offset = offset;
+        entry.width = raster->width;
+        entry.height = raster->height;
+        g_byte_array_append (data, (const guint8 *) &entry, sizeof (entry));
+
+        offset += cairo_format_stride_for_width (CAIRO_FORMAT_A8, raster->width) * raster->height;
+    }
+
+    for (idx = 0; idx < rasters->len; idx++) {
+        DiskCacheRaster *raster = g_ptr_array_index (rasters, idx);
+
+        g_byte_array_append (data, raster->data,
+                             cairo_format_stride_for_width (CAIRO_FORMAT_A8, raster->width) *
+                             raster->height);
+    }
+
+    if (g_mkdir_with_parents (dir, 0755) != 0) {
+        g_warning ("Can't save the font thumbnails: unable to create %s: %s",
+                   dir, g_strerror (errno));
+        g_task_return_boolean (task, FALSE);
+        return;
+    }
+
+    if (!g_file_set_contents (path, (const gchar *) data->data, data->len, &error)) {
+        g_warning ("Can't save the font thumbnails: %s", error->message);
+        g_task_return_boolean (task, FALSE);
+        return;
+    }
+
+    new_file = disk_cache_open ();
+
+    G_LOCK (disk_cache);
+    g_clear_pointer (&disk_cache_file, g_mapped_file_unref);
+    disk_cache_file = new_file;
+    G_UNLOCK (disk_cache);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+static gboolean disk_cache_flush_timeout (gpointer user_data);
+
+static void
+disk_cache_written (GObject *source_object,
+                    GAsyncResult *res,
+                    gpointer user_data)
+{
+    disk_cache_flushing = FALSE;
+
+    /* More came in while writing. */
+    if (disk_cache_pending != NULL && disk_cache_flush_id == 0)
+        disk_cache_flush_id = g_timeout_add_seconds (DISK_CACHE_FLUSH_DELAY_S,
+                                                     disk_cache_flush_timeout, NULL);
+}
+
+static gboolean
+disk_cache_flush_timeout (gpointer user_data)
+{
+    g_autoptr(GTask) task = NULL;
+
+    /* One writer at a time; try again later. */
+    if (disk_cache_flushing)
+        return G_SOURCE_CONTINUE;
+
+    disk_cache_flush_id = 0;
+    disk_cache_flushing = TRUE;
+
+    task = g_task_new (NULL, NULL, disk_cache_written, NULL);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_set_task_data (task, g_steal_pointer (&disk_cache_pending),
+                          (GDestroyNotify) g_ptr_array_unref);
+    g_task_run_in_thread (task, disk_cache_write);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Queues a freshly rendered thumbnail to be saved. The raster travels
+ * as user data on the surface, which stays alive until it is written. */
+static void
+disk_cache_add (ThumbnailJob *job,
+                cairo_surface_t *surface)
+{
+    DiskCacheRaster *raster = g_slice_new0 (DiskCacheRaster);
+
+    raster->key = job->key;
+    raster->data = cairo_image_surface_get_data (surface);
+    raster->width = cairo_image_surface_get_width (surface);
+    raster->height = cairo_image_surface_get_height (surface);
+    cairo_surface_set_user_data (surface, &raster_key, raster,
+                                 (cairo_destroy_func_t) disk_cache_raster_free);
+
+    if (disk_cache_pending == NULL)
+        disk_cache_pending = g_ptr_array_new_with_free_func ((GDestroyNotify) cairo_surface_destroy);
+    g_ptr_array_add (disk_cache_pending, cairo_surface_reference (surface));
+
+    if (disk_cache_flush_id == 0)
+        disk_cache_flush_id = g_timeout_add_seconds (DISK_CACHE_FLUSH_DELAY_S,
+                                                     disk_cache_flush_timeout, NULL);
+}
+
+static void
+render_thread (gpointer data,
+               gpointer user_data)
+{
+    g_autoptr(GTask) task = data;
+    ThumbnailJob *job = g_task_get_task_data (task);
+    GError *error = NULL;
+    cairo_surface_t *surface;
+    FT_Library library;
+
+    /* Cells that left the screen cancel their requests while queued. */
+    if (g_task_return_error_if_cancelled (task))
+        return;
+
+    job->key = thumbnail_key (job->path, job->face_index, job->text,
+                              job->size, job->scale, job->max_width);
+
+    surface = disk_cache_lookup (job);
+    if (surface != NULL) {
+        g_task_return_pointer (task, surface, (GDestroyNotify) cairo_surface_destroy);
+        return;
+    }
+
+    library = get_thread_library ();
+    if (library == NULL) {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED,
+                                 "Unable to initialize FreeType");
+        return;
+    }
+
+    surface = render_thumbnail (library, job, &error);
+    job->rendered = surface != NULL;
+
+    if (surface == NULL)
+        g_task_return_error (task, error);
+    else
+        g_task_return_pointer (task, surface, (GDestroyNotify) cairo_surface_destroy);
+}
+
+/* Lower priority values first, then first come, first served. */
+static gint
+compare_tasks (gconstpointer a,
+               gconstpointer b,
+               gpointer user_data)
+{
+    GTask *task_a = (GTask *) a;
+    GTask *task_b = (GTask *) b;
+    ThumbnailJob *job_a = g_task_get_task_data (task_a);
+    ThumbnailJob *job_b = g_task_get_task_data (task_b);
+    gint priority_a = g_task_get_priority (task_a);
+    gint priority_b = g_task_get_priority (task_b);
+
+    if (priority_a != priority_b)
+        return priority_a < priority_b ? -1 : 1;
+
+    return job_a->sequence < job_b->sequence ? -1 : 1;
+}
+
+static GThreadPool *
+get_render_pool (void)
+{
+    static GThreadPool *pool = NULL;
+
+    if (g_once_init_enter (&pool)) {
+        GThreadPool *retval;
+
+        retval = g_thread_pool_new (render_thread, NULL,
+                                    CLAMP ((gint) g_get_num_processors () - 1, 1, MAX_RENDER_THREADS),
+                                    FALSE, NULL);
+        g_thread_pool_set_sort_function (retval, compare_tasks, NULL);
+
+        g_once_init_leave (&pool, retval);
+    }
+
+    return pool;
+}
+
+/* Renders @text in face @face_index of @file, at @size pixels for a
+ * display with @scale, within @max_width pixels. Requests run in
+ * @priority order, as for GLib sources. */
+void
+font_thumbnail_render_async (GFile *file,
+                             gint face_index,
+                             const gchar *text,
+                             gint size,
+                             gint scale,
+                             gint max_width,
+                             gint priority,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+    g_autoptr(GTask) task = g_task_new (NULL, cancellable, callback, user_data);
+    ThumbnailJob *job = g_slice_new0 (ThumbnailJob);
+
+    job->path = g_file_get_path (file);
+    job->face_index = face_index;
+    job->text = g_strdup (text);
+    job->size = size;
+    job->scale = scale;
+    job->max_width = max_width;
+    job->sequence = next_sequence++;
+
+    g_task_set_task_data (task, job, (GDestroyNotify) thumbnail_job_free);
+    g_task_set_priority (task, priority);
+
+    if (job->path == NULL) {
+        g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                                 "Thumbnails need a local font file");
+        return;
+    }
+
+    g_thread_pool_push (get_render_pool (), g_steal_pointer (&task), NULL);
+}
+
+/* Returns the rendered thumbnail, which is also added to the cache and
+ * queued to be saved to disk if it wasn't read from there. */
+cairo_surface_t *
+font_thumbnail_render_finish (GAsyncResult *result,
+                              GError **error)
+{
+    ThumbnailJob *job = g_task_get_task_data (G_TASK (result));
+    cairo_surface_t *surface;
+
+    surface = g_task_propagate_pointer (G_TASK (result), error);
+    if (surface == NULL)
+        return NULL;
+
+    if (job->key == 0)
+        return surface;
+
+    thumbnail_cache_insert (job->key, surface);
+
+    if (job->rendered)
+        disk_cache_add (job, surface);
+
+    return surface;
+}
@@ -0,0 +1,47 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_THUMBNAIL_H__
+#define __FONT_THUMBNAIL_H__
+
+#include <cairo.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+cairo_surface_t *font_thumbnail_lookup (GFile *file,
+                                        gint face_index,
+                                        const gchar *text,
+                                        gint size,
+                                        gint scale,
+                                        gint max_width);
+
+void font_thumbnail_render_async (GFile *file,
+                                  gint face_index,
+                                  const gchar *text,
+                                  gint size,
+                                  gint scale,
+                                  gint max_width,
+                                  gint priority,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data);
+
+cairo_surface_t *font_thumbnail_render_finish (GAsyncResult *result,
+                                               GError **error);
+
+G_END_DECLS
+
+#endif /* __FONT_THUMBNAIL_H__ */
@@ -0,0 +1,1074 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "font-view-grid.h"
+#include "font-model.h"
+#include "font-thumbnail.h"
+
+/* A scrollable grid of font names that only has labels for the rows
+ * on screen, plus a few rows above and below. Cells have a fixed size,
+ * so the layout of any row is known without measuring the ones before
+ * it, and scrolling just rebinds the labels to other model items.
+ *
+ * Above its label each cell shows the name rendered in the font itself.
+ * Those thumbnails are requested when a cell is bound, visible rows
+ * first, and the request is cancelled when the cell is bound to
+ * something else before it is done.
+ */
+
+#define COLUMN_SPACING 18
+#define ROW_SPACING 6
+#define MARGIN 16
+#define CELL_PADDING 6
+#define CELL_WIDTH_CHARS 18
+#define OVERSCAN_ROWS 2
+#define THUMBNAIL_SIZE 24
+#define THUMBNAIL_HEIGHT 40
+
+enum {
+    PROP_0,
+    PROP_HADJUSTMENT,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY,
+};
+
+enum {
+    ITEM_ACTIVATED,
+    NUM_SIGNALS
+};
+
+struct _FontViewGrid {
+    GtkContainer parent_instance;
+
+    GListModel *model;
+    /* Model positions to show, or NULL to show all of the model. */
+    GArray *filter;
+
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+    guint hscroll_policy : 1;
+    guint vscroll_policy : 1;
+    gboolean in_allocate;
+
+    /* Labels, recycled as the view scrolls, and the item each one
+     * shows; spare cells are hidden and bound to nothing. */
+    GPtrArray *cells;
+    GPtrArray *cell_items;
+    /* The thumbnail of each cell's item, or the request for it. */
+    GPtrArray *cell_thumbnails;
+    GPtrArray *cell_requests;
+    /* The shown positions the cells are bound to. */
+    guint first_position;
+    guint last_position;
+    gint thumbnail_scale;
+
+    gint cell_width;
+    gint cell_height;
+    guint n_columns;
+    gint x_offset;
+
+    gint focus_position;
+    gint pressed_position;
+};
+
+static guint signals[NUM_SIGNALS] = { 0, };
+
+typedef struct {
+    FontViewGrid *self;
+    FontViewModelItem *item;
+} ThumbnailRequest;
+
+G_DEFINE_TYPE_WITH_CODE (FontViewGrid, font_view_grid, GTK_TYPE_CONTAINER,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL))
+
+static guint
+font_view_grid_get_n_items (FontViewGrid *self)
+{
+    if (self->model == NULL)
+        return 0;
+
+    if (self->filter != NULL)
+        return self->filter->len;
+
+    return g_list_model_get_n_items (self->model);
+}
+
+/* Returns the item shown at @position, which counts shown items only. */
+static FontViewModelItem *
+font_view_grid_get_item (FontViewGrid *self,
+                         guint position)
+{
+    if (self->filter != NULL)
+        position = g_array_index (self->filter, guint, position);
+
+    return g_list_model_get_item (self->model, position);
+}
+
+static gint
+font_view_grid_get_row_height (FontViewGrid *self)
+{
+    return self->cell_height + ROW_SPACING;
+}
+
+static gint
+font_view_grid_get_content_height (FontViewGrid *self)
+{
+    guint n_rows;
+
+    n_rows = (font_view_grid_get_n_items (self) + self->n_columns - 1) / self->n_columns;
+
+    return 2 * MARGIN + n_rows * font_view_grid_get_row_height (self) - ROW_SPACING;
+}
+
+static GtkWidget *
+font_view_grid_create_cell (FontViewGrid *self)
+{
+    GtkWidget *label = gtk_label_new (NULL);
+
+    gtk_label_set_line_wrap (GTK_LABEL (label), TRUE);
+    gtk_label_set_line_wrap_mode (GTK_LABEL (label), PANGO_WRAP_WORD_CHAR);
+    gtk_label_set_lines (GTK_LABEL (label), 2);
+    gtk_label_set_ellipsize (GTK_LABEL (label), PANGO_ELLIPSIZE_END);
+    gtk_label_set_width_chars (GTK_LABEL (label), CELL_WIDTH_CHARS);
+    gtk_label_set_max_width_chars (GTK_LABEL (label), CELL_WIDTH_CHARS);
+    gtk_label_set_justify (GTK_LABEL (label), GTK_JUSTIFY_CENTER);
+    gtk_label_set_yalign (GTK_LABEL (label), 0.0);
+
+    gtk_widget_set_parent (label, GTK_WIDGET (self));
+    gtk_widget_set_child_visible (label, FALSE);
+    gtk_widget_show (label);
+
+    g_ptr_array_add (self->cells, label);
+    g_ptr_array_add (self->cell_items, NULL);
+    g_ptr_array_add (self->cell_thumbnails, NULL);
+    g_ptr_array_add (self->cell_requests, NULL);
+
+    return label;
+}
+
+/* Measures a cell holding a thumbnail and two full lines of text,
+ * with the current style. */
+static void
+font_view_grid_ensure_cell_size (FontViewGrid *self)
+{
+    GtkWidget *cell;
+    gint width, height;
+
+    if (self->cell_width > 0)
+        return;
+
+    if (self->cells->len == 0)
+        font_view_grid_create_cell (self);
+
+    cell = g_ptr_array_index (self->cells, self->cells->len - 1);
+    gtk_label_set_text (GTK_LABEL (cell), "Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg Mg");
+    gtk_widget_get_preferred_width (cell, NULL, &width);
+    gtk_widget_get_preferred_height_for_width (cell, width, NULL, &height);
+
+    /* It is bound to something else on the next layout. */
+    g_clear_object (&g_ptr_array_index (self->cell_items, self->cells->len - 1));
+
+    self->cell_width = width + 2 * CELL_PADDING;
+    self->cell_height = THUMBNAIL_HEIGHT + height + 2 * CELL_PADDING;
+}
+
+static void
+cancel_request (gpointer data)
+{
+    GCancellable *cancellable = data;
+
+    if (cancellable == NULL)
+        return;
+
+    g_cancellable_cancel (cancellable);
+    g_object_unref (cancellable);
+}
+
+static void
+font_view_grid_unbind_thumbnail (FontViewGrid *self,
+                                 guint cell)
+{
+    cancel_request (g_ptr_array_index (self->cell_requests, cell));
+    g_ptr_array_index (self->cell_requests, cell) = NULL;
+    g_clear_pointer (&g_ptr_array_index (self->cell_thumbnails, cell), cairo_surface_destroy);
+}
+
+static void
+thumbnail_rendered_cb (GObject *source_object,
+                       GAsyncResult *res,
+                       gpointer user_data)
+{
+    ThumbnailRequest *request = user_data;
+    FontViewGrid *self = request->self;
+    cairo_surface_t *surface = font_thumbnail_render_finish (res, NULL);
+    gdouble scale = 0;
+    guint cell;
+
+    if (surface != NULL)
+        cairo_surface_get_device_scale (surface, &scale, NULL);
+
+    /* Fonts that fail to render keep just their label. */
+    if (surface != NULL && (gint) scale == self->thumbnail_scale &&
+        g_ptr_array_find (self->cell_items, request->item, &cell)) {
+        cairo_surface_destroy (g_ptr_array_index (self->cell_thumbnails, cell));
+        g_ptr_array_index (self->cell_thumbnails, cell) = g_steal_pointer (&surface);
+        gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+
+    g_clear_pointer (&surface, cairo_surface_destroy);
+    g_object_unref (request->self);
+    g_object_unref (request->item);
+    g_slice_free (ThumbnailRequest, request);
+}
+
+static void
+font_view_grid_bind_thumbnail (FontViewGrid *self,
+                               guint cell,
+                               FontViewModelItem *item,
+                               gint priority)
+{
+    GFile *file = font_view_model_item_get_font_file (item);
+    gint face_index = font_view_model_item_get_face_index (item);
+    const gchar *text = font_view_model_item_get_font_name (item);
+    gint max_width = self->cell_width - 2 * CELL_PADDING;
+    GCancellable *cancellable;
+    ThumbnailRequest *request;
+    cairo_surface_t *surface;
+
+    font_view_grid_unbind_thumbnail (self, cell);
+
+    surface = font_thumbnail_lookup (file, face_index, text, THUMBNAIL_SIZE,
+                                     self->thumbnail_scale, max_width);
+    if (surface != NULL) {
+        g_ptr_array_index (self->cell_thumbnails, cell) = cairo_surface_reference (surface);
+        return;
+    }
+
+    request = g_slice_new0 (ThumbnailRequest);
+    request->self = g_object_ref (self);
+    request->item = g_object_ref (item);
+
+    cancellable = g_cancellable_new ();
+    g_ptr_array_index (self->cell_requests, cell) = cancellable;
+
+    font_thumbnail_render_async (file, face_index, text, THUMBNAIL_SIZE,
+                                 self->thumbnail_scale, max_width,
+                                 priority, cancellable, thumbnail_rendered_cb, request);
+}
+
+static void
+font_view_grid_get_cell_area (FontViewGrid *self,
+                              guint position,
+                              GdkRectangle *area)
+{
+    guint row = position / self->n_columns;
+    guint column = position % self->n_columns;
+
+    area->x = self->x_offset + column * (self->cell_width + COLUMN_SPACING);
+    area->y = MARGIN + row * font_view_grid_get_row_height (self) -
+        (gint) gtk_adjustment_get_value (self->vadjustment);
+    area->width = self->cell_width;
+    area->height = self->cell_height;
+}
+
+static gint
+font_view_grid_get_position_at (FontViewGrid *self,
+                                gdouble x,
+                                gdouble y)
+{
+    gint column_width = self->cell_width + COLUMN_SPACING;
+    gint row_height = font_view_grid_get_row_height (self);
+    gint column, row, position;
+
+    x -= self->x_offset;
+    y += gtk_adjustment_get_value (self->vadjustment) - MARGIN;
+
+    if (x < 0 || y < 0)
+        return -1;
+
+    column = (gint) x / column_width;
+    row = (gint) y / row_height;
+
+    /* Clicks in the spacing between cells don't count. */
+    if (column >= (gint) self->n_columns ||
+        (gint) x % column_width >= self->cell_width ||
+        (gint) y % row_height >= self->cell_height)
+        return -1;
+
+    position = row * self->n_columns + column;
+    if (position >= (gint) font_view_grid_get_n_items (self))
+        return -1;
+
+    return position;
+}
+
+static void
+font_view_grid_update_adjustments (FontViewGrid *self)
+{
+    GtkAllocation allocation;
+    gdouble value;
+    gint content_height;
+
+    gtk_widget_get_allocation (GTK_WIDGET (self), &allocation);
+    content_height = MAX (font_view_grid_get_content_height (self), allocation.height);
+
+    value = CLAMP (gtk_adjustment_get_value (self->vadjustment),
+                   0, content_height - allocation.height);
+    gtk_adjustment_configure (self->vadjustment, value, 0, content_height,
+                              font_view_grid_get_row_height (self),
+                              allocation.height * 0.9, allocation.height);
+    gtk_adjustment_configure (self->hadjustment, 0, 0, allocation.width,
+                              allocation.width * 0.1, allocation.width * 0.9,
+                              allocation.width);
+}
+
+/* Returns the position cell @cell is bound to, which is past the last
+ * one if it is spare. Each position has a fixed cell, the position
+ * modulo the number of cells, so scrolling only rebinds the cells of
+ * rows that enter or leave the view. */
+static guint
+font_view_grid_get_cell_position (FontViewGrid *self,
+                                  guint cell)
+{
+    guint n_cells = self->cells->len;
+
+    return self->first_position +
+        (cell + n_cells - self->first_position % n_cells) % n_cells;
+}
+
+/* Binds a label to each item in the visible rows and places it. */
+static void
+font_view_grid_layout_cells (FontViewGrid *self)
+{
+    GtkAllocation allocation;
+    gint row_height = font_view_grid_get_row_height (self);
+    gdouble value = gtk_adjustment_get_value (self->vadjustment);
+    guint n_items = font_view_grid_get_n_items (self);
+    gint first_row, last_row, scale;
+    guint first, last, idx;
+
+    gtk_widget_get_allocation (GTK_WIDGET (self), &allocation);
+
+    /* Thumbnails are rendered for one scale; rebind them all. */
+    scale = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+    if (scale != self->thumbnail_scale) {
+        for (idx = 0; idx < self->cells->len; idx++) {
+            g_clear_object (&g_ptr_array_index (self->cell_items, idx));
+            font_view_grid_unbind_thumbnail (self, idx);
+        }
+
+        self->thumbnail_scale = scale;
+    }
+
+    first_row = MAX (0, (gint) (value - MARGIN) / row_height - OVERSCAN_ROWS);
+    last_row = (gint) (value + allocation.height - MARGIN) / row_height + OVERSCAN_ROWS;
+    first = MIN (first_row * self->n_columns, n_items);
+    last = MIN ((last_row + 1) * self->n_columns, n_items);
+
+    while (self->cells->len < last - first)
+        font_view_grid_create_cell (self);
+
+    self->first_position = first;
+    self->last_position = last;
+
+    for (idx = 0; idx < self->cells->len; idx++) {
+        GtkWidget *cell = g_ptr_array_index (self->cells, idx);
+        gpointer *bound_item = &g_ptr_array_index (self->cell_items, idx);
+        guint position = font_view_grid_get_cell_position (self, idx);
+        g_autoptr(FontViewModelItem) item = NULL;
+        GdkRectangle area;
+
+        if (position >= last) {
+            gtk_widget_set_child_visible (cell, FALSE);
+            g_clear_object (bound_item);
+            font_view_grid_unbind_thumbnail (self, idx);
+            continue;
+        }
+
+        font_view_grid_get_cell_area (self, position, &area);
+
+        item = font_view_grid_get_item (self, position);
+        if (item != *bound_item) {
+            gboolean visible = area.y + area.height > 0 && area.y < allocation.height;
+
+            gtk_label_set_text (GTK_LABEL (cell), font_view_model_item_get_font_name (item));
+            g_set_object (bound_item, item);
+            font_view_grid_bind_thumbnail (self, idx, item,
+                                           visible ? G_PRIORITY_DEFAULT : G_PRIORITY_LOW);
+        }
+
+        area.x += CELL_PADDING;
+        area.y += CELL_PADDING + THUMBNAIL_HEIGHT;
+        area.width -= 2 * CELL_PADDING;
+        area.height -= 2 * CELL_PADDING + THUMBNAIL_HEIGHT;
+
+        gtk_widget_set_child_visible (cell, TRUE);
+        gtk_widget_size_allocate (cell, &area);
+    }
+}
+
+static void
+font_view_grid_size_allocate (GtkWidget *widget,
+                              GtkAllocation *allocation)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+    gint available, used;
+
+    gtk_widget_set_allocation (widget, allocation);
+
+    if (gtk_widget_get_realized (widget))
+        gdk_window_move_resize (gtk_widget_get_window (widget),
+                                allocation->x, allocation->y,
+                                allocation->width, allocation->height);
+
+    font_view_grid_ensure_cell_size (self);
+
+    available = allocation->width - 2 * MARGIN + COLUMN_SPACING;
+    self->n_columns = MAX (1, available / (self->cell_width + COLUMN_SPACING));
+
+    /* Center the columns, like a flow box would spread them. */
+    used = self->n_columns * (self->cell_width + COLUMN_SPACING);
+    self->x_offset = MARGIN + MAX (0, available - used) / 2;
+
+    self->in_allocate = TRUE;
+    font_view_grid_update_adjustments (self);
+    self->in_allocate = FALSE;
+
+    font_view_grid_layout_cells (self);
+}
+
+static void
+font_view_grid_get_preferred_width (GtkWidget *widget,
+                                    gint *minimum,
+                                    gint *natural)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+
+    font_view_grid_ensure_cell_size (self);
+
+    *minimum = 2 * MARGIN + self->cell_width;
+    *natural = 2 * MARGIN + 4 * self->cell_width + 3 * COLUMN_SPACING;
+}
+
+static void
+font_view_grid_get_preferred_height (GtkWidget *widget,
+                                     gint *minimum,
+                                     gint *natural)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+
+    font_view_grid_ensure_cell_size (self);
+
+    *minimum = *natural = 2 * MARGIN + self->cell_height;
+}
+
+static void
+font_view_grid_realize (GtkWidget *widget)
+{
+    GtkAllocation allocation;
+    GdkWindowAttr attributes = { 0, };
+    GdkWindow *window;
+
+    gtk_widget_set_realized (widget, TRUE);
+    gtk_widget_get_allocation (widget, &allocation);
+
+    attributes.window_type = GDK_WINDOW_CHILD;
+    attributes.x = allocation.x;
+    attributes.y = allocation.y;
+    attributes.width = allocation.width;
+    attributes.height = allocation.height;
+    attributes.wclass = GDK_INPUT_OUTPUT;
+    attributes.visual = gtk_widget_get_visual (widget);
+    attributes.event_mask = gtk_widget_get_events (widget) |
+        GDK_BUTTON_PRESS_MASK | GDK_BUTTON_RELEASE_MASK;
+
+    window = gdk_window_new (gtk_widget_get_parent_window (widget),
+                             &attributes, GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL);
+    gtk_widget_set_window (widget, window);
+    gtk_widget_register_window (widget, window);
+}
+
+/* Paints the thumbnails, which are coverage masks, in the text color
+ * and centered above the labels. */
+static void
+font_view_grid_draw_thumbnails (FontViewGrid *self,
+                                cairo_t *cr)
+{
+    GtkStyleContext *context = gtk_widget_get_style_context (GTK_WIDGET (self));
+    GdkRGBA color;
+    guint idx;
+
+    gtk_style_context_get_color (context, gtk_style_context_get_state (context), &color);
+
+    for (idx = 0; idx < self->cells->len; idx++) {
+        cairo_surface_t *thumbnail = g_ptr_array_index (self->cell_thumbnails, idx);
+        guint position = font_view_grid_get_cell_position (self, idx);
+        GdkRectangle area;
+        gint width, height;
+
+        if (thumbnail == NULL || position >= self->last_position)
+            continue;
+
+        font_view_grid_get_cell_area (self, position, &area);
+        width = cairo_image_surface_get_width (thumbnail) / self->thumbnail_scale;
+        height = cairo_image_surface_get_height (thumbnail) / self->thumbnail_scale;
+
+        cairo_save (cr);
+        cairo_rectangle (cr, area.x + CELL_PADDING, area.y + CELL_PADDING,
+                         area.width - 2 * CELL_PADDING, THUMBNAIL_HEIGHT);
+        cairo_clip (cr);
+        gdk_cairo_set_source_rgba (cr, &color);
+        cairo_mask_surface (cr, thumbnail,
+                            area.x + (area.width - width) / 2,
+                            area.y + CELL_PADDING + (THUMBNAIL_HEIGHT - height) / 2);
+        cairo_restore (cr);
+    }
+}
+
+static gboolean
+font_view_grid_draw (GtkWidget *widget,
+                     cairo_t *cr)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+    GtkStyleContext *context = gtk_widget_get_style_context (widget);
+
+    gtk_render_background (context, cr, 0, 0,
+                           gtk_widget_get_allocated_width (widget),
+                           gtk_widget_get_allocated_height (widget));
+
+    if (gtk_widget_has_visible_focus (widget) &&
+        self->focus_position >= 0 &&
+        self->focus_position < (gint) font_view_grid_get_n_items (self)) {
+        GdkRectangle area;
+
+        font_view_grid_get_cell_area (self, self->focus_position, &area);
+        gtk_render_focus (context, cr, area.x, area.y, area.width, area.height);
+    }
+
+    font_view_grid_draw_thumbnails (self, cr);
+
+    return GTK_WIDGET_CLASS (font_view_grid_parent_class)->draw (widget, cr);
+}
+
+static void
+font_view_grid_scroll_to_position (FontViewGrid *self,
+                                   gint position)
+{
+    gint row_height = font_view_grid_get_row_height (self);
+    gint top = MARGIN + (position / self->n_columns) * row_height;
+
+    gtk_adjustment_clamp_page (self->vadjustment,
+                               top - ROW_SPACING, top + row_height);
+}
+
+static void
+font_view_grid_set_focus_position (FontViewGrid *self,
+                                   gint position)
+{
+    self->focus_position = position;
+    font_view_grid_scroll_to_position (self, position);
+    gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+static void
+font_view_grid_activate_position (FontViewGrid *self,
+                                  gint position)
+{
+    g_autoptr(FontViewModelItem) item = font_view_grid_get_item (self, position);
+
+    g_signal_emit (self, signals[ITEM_ACTIVATED], 0, item);
+}
+
+static gboolean
+font_view_grid_button_press_event (GtkWidget *widget,
+                                   GdkEventButton *event)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+
+    if (event->button != GDK_BUTTON_PRIMARY || event->type != GDK_BUTTON_PRESS)
+        return FALSE;
+
+    if (!gtk_widget_has_focus (widget))
+        gtk_widget_grab_focus (widget);
+
+    self->pressed_position = font_view_grid_get_position_at (self, event->x, event->y);
+
+    return TRUE;
+}
+
+static gboolean
+font_view_grid_button_release_event (GtkWidget *widget,
+                                     GdkEventButton *event)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+    gint position;
+
+    if (event->button != GDK_BUTTON_PRIMARY)
+        return FALSE;
+
+    position = font_view_grid_get_position_at (self, event->x, event->y);
+    if (position >= 0 && position == self->pressed_position) {
+        self->focus_position = position;
+        gtk_widget_queue_draw (widget);
+        font_view_grid_activate_position (self, position);
+    }
+
+    self->pressed_position = -1;
+
+    return TRUE;
+}
+
+static gboolean
+font_view_grid_key_press_event (GtkWidget *widget,
+                                GdkEventKey *event)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+    gint n_items = font_view_grid_get_n_items (self);
+    gint page_rows, position;
+
+    if (n_items == 0)
+        return GTK_WIDGET_CLASS (font_view_grid_parent_class)->key_press_event (widget, event);
+
+    page_rows = MAX (1, gtk_adjustment_get_page_size (self->vadjustment) /
+                     font_view_grid_get_row_height (self));
+    position = MAX (self->focus_position, 0);
+
+    switch (event->keyval) {
+    case GDK_KEY_Left:
+    case GDK_KEY_KP_Left:
+        position -= 1;
+        break;
+    case GDK_KEY_Right:
+    case GDK_KEY_KP_Right:
+        position += 1;
+        break;
+    case GDK_KEY_Up:
+    case GDK_KEY_KP_Up:
+        position -= self->n_columns;
+        break;
+    case GDK_KEY_Down:
+    case GDK_KEY_KP_Down:
+        position += self->n_columns;
+        break;
+    case GDK_KEY_Page_Up:
+    case GDK_KEY_KP_Page_Up:
+        position -= page_rows * self->n_columns;
+        break;
+    case GDK_KEY_Page_Down:
+    case GDK_KEY_KP_Page_Down:
+        position += page_rows * self->n_columns;
+        break;
+    case GDK_KEY_Home:
+    case GDK_KEY_KP_Home:
+        position = 0;
+        break;
+    case GDK_KEY_End:
+    case GDK_KEY_KP_End:
+        position = n_items - 1;
+        break;
+    case GDK_KEY_Return:
+    case GDK_KEY_KP_Enter:
+    case GDK_KEY_ISO_Enter:
+    case GDK_KEY_space:
+    case GDK_KEY_KP_Space:
+        if (self->focus_position >= 0 && self->focus_position < n_items)
+            font_view_grid_activate_position (self, self->focus_position);
+        return TRUE;
+    default:
+        return GTK_WIDGET_CLASS (font_view_grid_parent_class)->key_press_event (widget, event);
+    }
+
+    font_view_grid_set_focus_position (self, CLAMP (position, 0, n_items - 1));
+
+    return TRUE;
+}
+
+static gboolean
+font_view_grid_focus_in_event (GtkWidget *widget,
+                               GdkEventFocus *event)
+{
+    gtk_widget_queue_draw (widget);
+
+    return GTK_WIDGET_CLASS (font_view_grid_parent_class)->focus_in_event (widget, event);
+}
+
+static gboolean
+font_view_grid_focus_out_event (GtkWidget *widget,
+                                GdkEventFocus *event)
+{
+    gtk_widget_queue_draw (widget);
+
+    return GTK_WIDGET_CLASS (font_view_grid_parent_class)->focus_out_event (widget, event);
+}
+
+static void
+font_view_grid_style_updated (GtkWidget *widget)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (widget);
+
+    GTK_WIDGET_CLASS (font_view_grid_parent_class)->style_updated (widget);
+
+    self->cell_width = self->cell_height = 0;
+    gtk_widget_queue_resize (widget);
+}
+
+static void
+font_view_grid_forall (GtkContainer *container,
+                       gboolean include_internals,
+                       GtkCallback callback,
+                       gpointer callback_data)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (container);
+    guint idx;
+
+    /* The callback may remove the cell. */
+    for (idx = self->cells->len; idx > 0; idx--)
+        callback (g_ptr_array_index (self->cells, idx - 1), callback_data);
+}
+
+static void
+font_view_grid_remove (GtkContainer *container,
+                       GtkWidget *widget)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (container);
+    guint idx;
+
+    if (!g_ptr_array_find (self->cells, widget, &idx))
+        return;
+
+    gtk_widget_unparent (widget);
+    g_ptr_array_remove_index (self->cells, idx);
+    g_ptr_array_remove_index (self->cell_items, idx);
+    g_ptr_array_remove_index (self->cell_thumbnails, idx);
+    g_ptr_array_remove_index (self->cell_requests, idx);
+}
+
+static void
+font_view_grid_adjustment_value_changed (FontViewGrid *self)
+{
+    if (!self->in_allocate)
+        gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+static void
+font_view_grid_set_adjustment (FontViewGrid *self,
+                               GtkAdjustment **adjustment_ptr,
+                               GtkAdjustment *adjustment)
+{
+    if (adjustment != NULL && *adjustment_ptr == adjustment)
+        return;
+
+    if (*adjustment_ptr != NULL) {
+        g_signal_handlers_disconnect_by_func (*adjustment_ptr,
+                                              font_view_grid_adjustment_value_changed,
+                                              self);
+        g_clear_object (adjustment_ptr);
+    }
+
+    if (adjustment == NULL)
+        adjustment = gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+
+    *adjustment_ptr = g_object_ref_sink (adjustment);
+    g_signal_connect_swapped (adjustment, "value-changed",
+                              G_CALLBACK (font_view_grid_adjustment_value_changed),
+                              self);
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+static void
+font_view_grid_get_property (GObject *object,
+                             guint prop_id,
+                             GValue *value,
+                             GParamSpec *pspec)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (object);
+
+    switch (prop_id) {
+    case PROP_HADJUSTMENT:
+        g_value_set_object (value, self->hadjustment);
+        break;
+    case PROP_VADJUSTMENT:
+        g_value_set_object (value, self->vadjustment);
+        break;
+    case PROP_HSCROLL_POLICY:
+        g_value_set_enum (value, self->hscroll_policy);
+        break;
+    case PROP_VSCROLL_POLICY:
+        g_value_set_enum (value, self->vscroll_policy);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+font_view_grid_set_property (GObject *object,
+                             guint prop_id,
+                             const GValue *value,
+                             GParamSpec *pspec)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (object);
+
+    switch (prop_id) {
+    case PROP_HADJUSTMENT:
+        font_view_grid_set_adjustment (self, &self->hadjustment, g_value_get_object (value));
+        break;
+    case PROP_VADJUSTMENT:
+        font_view_grid_set_adjustment (self, &self->vadjustment, g_value_get_object (value));
+        break;
+    case PROP_HSCROLL_POLICY:
+        self->hscroll_policy = g_value_get_enum (value);
+        gtk_widget_queue_resize (GTK_WIDGET (self));
+        break;
+    case PROP_VSCROLL_POLICY:
+        self->vscroll_policy = g_value_get_enum (value);
+        gtk_widget_queue_resize (GTK_WIDGET (self));
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+        break;
+    }
+}
+
+static void
+font_view_grid_dispose (GObject *object)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (object);
+
+    font_view_grid_set_model (self, NULL);
+
+    while (self->cells->len > 0)
+        font_view_grid_remove (GTK_CONTAINER (self),
+                               g_ptr_array_index (self->cells, self->cells->len - 1));
+
+    if (self->hadjustment != NULL) {
+        g_signal_handlers_disconnect_by_func (self->hadjustment,
+                                              font_view_grid_adjustment_value_changed,
+                                              self);
+        g_clear_object (&self->hadjustment);
+    }
+
+    if (self->vadjustment != NULL) {
+        g_signal_handlers_disconnect_by_func (self->vadjustment,
+                                              font_view_grid_adjustment_value_changed,
+                                              self);
+        g_clear_object (&self->vadjustment);
+    }
+
+    G_OBJECT_CLASS (font_view_grid_parent_class)->dispose (object);
+}
+
+static void
+font_view_grid_finalize (GObject *object)
+{
+    FontViewGrid *self = FONT_VIEW_GRID (object);
+
+    g_ptr_array_unref (self->cells);
+    g_ptr_array_unref (self->cell_items);
+    g_ptr_array_unref (self->cell_thumbnails);
+    g_ptr_array_unref (self->cell_requests);
+    g_clear_pointer (&self->filter, g_array_unref);
+
+    G_OBJECT_CLASS (font_view_grid_parent_class)->finalize (object);
+}
+
+static void
+font_view_grid_init (FontViewGrid *self)
+{
+    gtk_widget_set_has_window (GTK_WIDGET (self), TRUE);
+    gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
+
+    self->cells = g_ptr_array_new ();
+    self->cell_items = g_ptr_array_new_with_free_func (g_object_unref);
+    self->cell_thumbnails = g_ptr_array_new_with_free_func ((GDestroyNotify) cairo_surface_destroy);
+    self->cell_requests = g_ptr_array_new_with_free_func (cancel_request);
+    self->n_columns = 1;
+    self->focus_position = -1;
+    self->pressed_position = -1;
+
+    font_view_grid_set_adjustment (self, &self->hadjustment, NULL);
+    font_view_grid_set_adjustment (self, &self->vadjustment, NULL);
+}
+
+static void
+font_view_grid_class_init (FontViewGridClass *klass)
+{
+    GObjectClass *oclass = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *wclass = GTK_WIDGET_CLASS (klass);
+    GtkContainerClass *cclass = GTK_CONTAINER_CLASS (klass);
+
+    oclass->get_property = font_view_grid_get_property;
+    oclass->set_property = font_view_grid_set_property;
+    oclass->dispose = font_view_grid_dispose;
+    oclass->finalize = font_view_grid_finalize;
+
+    wclass->realize = font_view_grid_realize;
+    wclass->size_allocate = font_view_grid_size_allocate;
+    wclass->get_preferred_width = font_view_grid_get_preferred_width;
+    wclass->get_preferred_height = font_view_grid_get_preferred_height;
+    wclass->draw = font_view_grid_draw;
+    wclass->button_press_event = font_view_grid_button_press_event;
+    wclass->button_release_event = font_view_grid_button_release_event;
+    wclass->key_press_event = font_view_grid_key_press_event;
+    wclass->focus_in_event = font_view_grid_focus_in_event;
+    wclass->focus_out_event = font_view_grid_focus_out_event;
+    wclass->style_updated = font_view_grid_style_updated;
+
+    cclass->forall = font_view_grid_forall;
+    cclass->remove = font_view_grid_remove;
+
+    g_object_class_override_property (oclass, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property (oclass, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property (oclass, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property (oclass, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+    signals[ITEM_ACTIVATED] =
+        g_signal_new ("item-activated",
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      0, NULL, NULL,
+                      g_cclosure_marshal_VOID__OBJECT,
+                      G_TYPE_NONE, 1, FONT_VIEW_TYPE_MODEL_ITEM);
+}
+
+GtkWidget *
+font_view_grid_new (void)
+{
+    return g_object_new (FONT_VIEW_TYPE_GRID, NULL);
+}
+
+static void
+font_view_grid_items_changed (FontViewGrid *self,
+                              guint position,
+                              guint removed,
+                              guint added)
+{
+    guint n_items;
+
+    /* The filter refers to old positions; whoever set it is expected
+     * to refresh it for the changed model. Until then the focus is
+     * tracked by model position. */
+    if (self->filter != NULL) {
+        if (self->focus_position >= 0 && self->focus_position < (gint) self->filter->len)
+            self->focus_position = g_array_index (self->filter, guint, self->focus_position);
+        g_clear_pointer (&self->filter, g_array_unref);
+    }
+
+    n_items = font_view_grid_get_n_items (self);
+
+    /* Keep the focus on the same item if it is still there. */
+    if (self->focus_position >= (gint) (position + removed))
+        self->focus_position += (gint) added - (gint) removed;
+    else if (self->focus_position >= (gint) position)
+        self->focus_position = MIN ((gint) position, (gint) n_items - 1);
+
+    self->pressed_position = -1;
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+void
+font_view_grid_set_model (FontViewGrid *self,
+                          GListModel *model)
+{
+    if (self->model == model)
+        return;
+
+    if (self->model != NULL)
+        g_signal_handlers_disconnect_by_func (self->model,
+                                              font_view_grid_items_changed,
+                                              self);
+
+    g_set_object (&self->model, model);
+    g_clear_pointer (&self->filter, g_array_unref);
+
+    if (self->model != NULL)
+        g_signal_connect_swapped (self->model, "items-changed",
+                                  G_CALLBACK (font_view_grid_items_changed),
+                                  self);
+
+    self->focus_position = -1;
+    self->pressed_position = -1;
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+/* Shows only the model items at @positions, which must be ascending,
+ * or the whole model again when @positions is NULL. The first shown
+ * item gets the focus, so Enter opens the best match right away. */
+void
+font_view_grid_set_filter (FontViewGrid *self,
+                           GArray *positions)
+{
+    if (self->filter == NULL && positions == NULL)
+        return;
+
+    g_clear_pointer (&self->filter, g_array_unref);
+    if (positions != NULL)
+        self->filter = g_array_ref (positions);
+
+    self->focus_position = font_view_grid_get_n_items (self) > 0 ? 0 : -1;
+    self->pressed_position = -1;
+    gtk_adjustment_set_value (self->vadjustment, 0);
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+/* Replaces the filter after the model changed, like set_filter() but
+ * without moving the view: the focus stays on the same item, or moves
+ * to the next one shown if that item is filtered out now. */
+void
+font_view_grid_refresh_filter (FontViewGrid *self,
+                               GArray *positions)
+{
+    gint focus = -1;
+    guint n_items, lo, hi;
+
+    if (self->filter == NULL && positions == NULL)
+        return;
+
+    if (self->focus_position >= 0 &&
+        self->focus_position < (gint) font_view_grid_get_n_items (self))
+        focus = self->filter != NULL ?
+            (gint) g_array_index (self->filter, guint, self->focus_position) :
+            self->focus_position;
+
+    g_clear_pointer (&self->filter, g_array_unref);
+    if (positions != NULL)
+        self->filter = g_array_ref (positions);
+
+    n_items = font_view_grid_get_n_items (self);
+
+    if (focus < 0 || n_items == 0) {
+        self->focus_position = -1;
+    } else if (self->filter == NULL) {
+        self->focus_position = MIN (focus, (gint) n_items - 1);
+    } else {
+        /* The first shown item at or after the focused one. */
+        lo = 0;
+        hi = n_items;
+        while (lo < hi) {
+            guint mid = lo + (hi - lo) / 2;
+
+            if (g_array_index (self->filter, guint, mid) < (guint) focus)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        self->focus_position = MIN (lo, n_items - 1);
+    }
+
+    self->pressed_position = -1;
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
@@ -0,0 +1,39 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FONT_VIEW_GRID_H__
+#define __FONT_VIEW_GRID_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define FONT_VIEW_TYPE_GRID (font_view_grid_get_type ())
+G_DECLARE_FINAL_TYPE (FontViewGrid, font_view_grid,
+                      FONT_VIEW, GRID,
+                      GtkContainer)
+
+GtkWidget *font_view_grid_new (void);
+
+void font_view_grid_set_model (FontViewGrid *self,
+                               GListModel *model);
+void font_view_grid_set_filter (FontViewGrid *self,
+                                GArray *positions);
+void font_view_grid_refresh_filter (FontViewGrid *self,
+                                    GArray *positions);
+
+G_END_DECLS
+
+#endif /* __FONT_VIEW_GRID_H__ */
@@ -0,0 +1,244 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sample-text.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define USER_TEXT_FILE "text.txt"
+
+/* The text is kept as one block of bytes, memory-mapped when it comes
+ * from a regular file, plus the offset of each line start. Lines are
+ * only validated when they are asked for, so opening a large corpus
+ * costs a single scan for line breaks.
+ */
+struct _SampleText {
+  gint ref_count;
+  GMappedFile *mapped_file;
+  GBytes *bytes;
+  const gchar *data;
+  gsize length;
+  GArray *line_starts;
+  GHashTable *fixed_lines;
+};
+
+#include "your-text.c"
+
+static SampleText *
+sample_text_new (void)
+{
+  SampleText *self = g_slice_new0 (SampleText);
+
+  self->ref_count = 1;
+  self->line_starts = g_array_new (FALSE, FALSE, sizeof (gsize));
+  self->fixed_lines = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                             NULL, g_free);
+
+  return self;
+}
+
+static void
+sample_text_index_lines (SampleText *self)
+{
+  const gchar *end = self->data + self->length;
+  const gchar *line = self->data;
+
+  while (line < end) {
+    const gchar *eol = memchr (line, '\n', end - line);
+    gsize start = line - self->data;
+
+    g_array_append_val (self->line_starts, start);
+
+    if (eol == NULL)
+      break;
+
+    line = eol + 1;
+  }
+
+  /* A sentinel past the last line, so every line ends at the next start. */
+  g_array_append_val (self->line_starts, self->length);
+  if (self->length > 0 && self->data[self->length - 1] != '\n')
+    g_array_index (self->line_starts, gsize, self->line_starts->len - 1) += 1;
+}
+
+static SampleText *
+sample_text_new_from_bytes (GBytes *bytes)
+{
+  SampleText *self = sample_text_new ();
+
+  self->bytes = bytes;
+  self->data = g_bytes_get_data (bytes, &self->length);
+  sample_text_index_lines (self);
+
+  return self;
+}
+
+static SampleText *
+sample_text_new_from_mapped_file (GMappedFile *mapped_file)
+{
+  SampleText *self = sample_text_new ();
+
+  self->mapped_file = mapped_file;
+  self->data = g_mapped_file_get_contents (mapped_file);
+  self->length = g_mapped_file_get_length (mapped_file);
+  sample_text_index_lines (self);
+
+  return self;
+}
+
+SampleText *
+sample_text_new_builtin (void)
+{
+  const gchar *builtin[] = {
+    line_1, line_2, line_3, line_4, line_5, line_6,
+    line_7, line_8, line_9, line_10, line_11, line_12
+  };
+  g_autoptr(GString) data = g_string_new (NULL);
+  gint idx;
+
+  for (idx = 0; idx < G_N_ELEMENTS (builtin); idx++) {
+    g_string_append (data, builtin[idx]);
+    g_string_append_c (data, '\n');
+  }
+
+  return sample_text_new_from_bytes (g_string_free_to_bytes (g_steal_pointer (&data)));
+}
+
+static GBytes *
+read_stdin (GError **error)
+{
+  g_autoptr(GString) data = g_string_new (NULL);
+  gchar buffer[4096];
+  gsize n_read;
+
+  while ((n_read = fread (buffer, 1, sizeof (buffer), stdin)) > 0)
+    g_string_append_len (data, buffer, n_read);
+
+  if (ferror (stdin)) {
+    g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_IO,
+                 "Unable to read the text from standard input");
+    return NULL;
+  }
+
+  return g_string_free_to_bytes (g_steal_pointer (&data));
+}
+
+/* Loads the sample text from @path, one line per line of the file.
+ * A path of "-" reads standard input. Files are mapped, not read, so
+ * only the pages of lines that get displayed are ever touched.
+ */
+SampleText *
+sample_text_new_from_file (const gchar *path,
+                           GError **error)
+{
+  GMappedFile *mapped_file;
+  GBytes *bytes;
+
+  if (g_strcmp0 (path, "-") == 0) {
+    bytes = read_stdin (error);
+    if (bytes == NULL)
+      return NULL;
+
+    return sample_text_new_from_bytes (bytes);
+  }
+
+  mapped_file = g_mapped_file_new (path, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  return sample_text_new_from_mapped_file (mapped_file);
+}
+
+/* Loads $XDG_CONFIG_HOME/showmytext/text.txt, if the user has one. */
+SampleText *
+sample_text_new_from_user_config (void)
+{
+  g_autofree gchar *path = NULL;
+  g_autoptr(GError) error = NULL;
+  SampleText *self;
+
+  path = g_build_filename (g_get_user_config_dir (), "showmytext",
+                           USER_TEXT_FILE, NULL);
+
+  if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    return NULL;
+
+  self = sample_text_new_from_file (path, &error);
+  if (self == NULL)
+    g_warning ("Can't load the sample text: %s", error->message);
+
+  return self;
+}
+
+SampleText *
+sample_text_ref (SampleText *self)
+{
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+sample_text_unref (SampleText *self)
+{
+  if (!g_atomic_int_dec_and_test (&self->ref_count))
+    return;
+
+  g_hash_table_unref (self->fixed_lines);
+  g_array_unref (self->line_starts);
+  g_clear_pointer (&self->bytes, g_bytes_unref);
+  g_clear_pointer (&self->mapped_file, g_mapped_file_unref);
+  g_slice_free (SampleText, self);
+}
+
+guint
+sample_text_get_n_lines (SampleText *self)
+{
+  return self->line_starts->len - 1;
+}
+
+/* Returns line @index as valid UTF-8, without its line break. The line
+ * is not nul-terminated; callers must rely on @length.
+ */
+const gchar *
+sample_text_get_line (SampleText *self,
+                      guint index,
+                      gsize *length)
+{
+  gsize start = g_array_index (self->line_starts, gsize, index);
+  gsize end = g_array_index (self->line_starts, gsize, index + 1) - 1;
+  const gchar *line = self->data + start;
+  const gchar *fixed;
+
+  /* Tolerate DOS line endings. */
+  if (end > start && line[end - start - 1] == '\r')
+    end--;
+
+  *length = end - start;
+
+  if (g_utf8_validate (line, *length, NULL))
+    return line;
+
+  fixed = g_hash_table_lookup (self->fixed_lines, GUINT_TO_POINTER (index));
+  if (fixed == NULL) {
+    fixed = g_utf8_make_valid (line, *length);
+    g_hash_table_insert (self->fixed_lines, GUINT_TO_POINTER (index), (gpointer) fixed);
+  }
+
+  *length = strlen (fixed);
+
+  return fixed;
+}
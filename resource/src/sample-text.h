@@ -0,0 +1,45 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SAMPLE_TEXT_H__
+#define __SAMPLE_TEXT_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _SampleText SampleText;
+
+SampleText *sample_text_new_builtin (void);
+
+SampleText *sample_text_new_from_file (const gchar *path,
+                                       GError **error);
+
+SampleText *sample_text_new_from_user_config (void);
+
+SampleText *sample_text_ref (SampleText *self);
+void sample_text_unref (SampleText *self);
+
+guint sample_text_get_n_lines (SampleText *self);
+
+const gchar *sample_text_get_line (SampleText *self,
+                                   guint index,
+                                   gsize *length);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SampleText, sample_text_unref)
+
+G_END_DECLS
+
+#endif /* __SAMPLE_TEXT_H__ */
@@ -24,22 +24,17 @@
 
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include FT_TYPE1_TABLES_H
-#include FT_SFNT_NAMES_H
-#include FT_TRUETYPE_IDS_H
-#include FT_MULTIPLE_MASTERS_H
 #include <fontconfig/fontconfig.h>
 #include <gio/gio.h>
 #include <gtk/gtk.h>
 #include <glib/gi18n.h>
 #include <libhandy-1/handy.h>
-#include <hb.h>
-#include <hb-ot.h>
-#include <hb-ft.h>
 
 /* #define GNOME_DESKTOP_USE_UNSTABLE_API */
 
+#include "font-info.h"
 #include "font-model.h"
+#include "font-view-grid.h"
 #include "sushi-font-widget.h"
 
 #define FONT_VIEW_TYPE_APPLICATION (font_view_application_get_type ())
@@ -64,84 +59,29 @@ struct _FontViewApplication {
     GtkWidget *swin_view;
     GtkWidget *swin_preview;
     GtkWidget *swin_info;
-    GtkWidget *flow_box;
+    GtkWidget *grid;
+    GtkWidget *search_bar;
+    GtkWidget *search_entry;
+    GtkWidget *coverage_button;
 
     FontViewModel *model;
+    SampleText *sample_text;
+    /* The codepoints of the sample text, for filtering by coverage. */
+    FontCoverageQuery *sample_query;
 
     GFile *font_file;
 
     GCancellable *cancellable;
+    /* The details of the font shown, while they are being read. */
+    GCancellable *info_cancellable;
 };
 
 G_DEFINE_TYPE (FontViewApplication, font_view_application,
                GTK_TYPE_APPLICATION);
 
-G_DECLARE_FINAL_TYPE (FontViewItem, font_view_item,
-                      FONT_VIEW, ITEM,
-                      GtkFlowBoxChild);
-
-struct _FontViewItem {
-    GtkFlowBoxChild parent;
-    GtkWidget *label;
-    FontViewModelItem *item;
-};
-
-#define FONT_VIEW_TYPE_ITEM (font_view_item_get_type ())
-G_DEFINE_TYPE (FontViewItem, font_view_item, GTK_TYPE_FLOW_BOX_CHILD)
-
-static void
-font_view_item_dispose (GObject *obj)
-{
-    FontViewItem *self = FONT_VIEW_ITEM (obj);
-
-    g_clear_object (&self->item);
-
-    G_OBJECT_CLASS (font_view_item_parent_class)->dispose (obj);
-}
-
-static void
-font_view_item_class_init (FontViewItemClass *klass)
-{
-    GObjectClass *oclass = G_OBJECT_CLASS (klass);
-    oclass->dispose = font_view_item_dispose;
-}
-
-static void
-font_view_item_init (FontViewItem *self)
-{
-    GtkWidget *box;
-
-    box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 6);
-    gtk_container_add (GTK_CONTAINER (self), box);
-
-    self->label = gtk_label_new (NULL);
-    gtk_widget_set_halign (self->label, GTK_ALIGN_CENTER);
-    gtk_label_set_line_wrap (GTK_LABEL (self->label), TRUE);
-    gtk_label_set_line_wrap_mode (GTK_LABEL (self->label), PANGO_WRAP_WORD_CHAR);
-    gtk_label_set_max_width_chars (GTK_LABEL (self->label), 18);
-    gtk_label_set_justify (GTK_LABEL (self->label), GTK_JUSTIFY_CENTER);
-    gtk_container_add (GTK_CONTAINER (box), self->label);
-}
-
-static GtkWidget *
-font_view_item_new (FontViewModelItem *item)
-{
-    FontViewItem *view_item = g_object_new (FONT_VIEW_TYPE_ITEM, NULL);
-
-    view_item->item = g_object_ref (item);
-    gtk_label_set_text (GTK_LABEL (view_item->label),
-                        font_view_model_item_get_font_name (item));
-    gtk_widget_show_all (GTK_WIDGET (view_item));
-
-    return GTK_WIDGET (view_item);
-}
-
 static void font_view_application_do_overview (FontViewApplication *self);
 static void ensure_window (FontViewApplication *self);
 
-#define VIEW_COLUMN_SPACING 18
-#define VIEW_MARGIN 16
-
 static gboolean
 _print_version_and_exit (const gchar *option_name,
                          const gchar *value,
@@ -153,68 +93,17 @@ _print_version_and_exit (const gchar *option_name,
     return TRUE;
 }
 
+static gchar *text_file = NULL;
+
 static const GOptionEntry goption_options[] =
 {
     { "version", 0, G_OPTION_FLAG_NO_ARG, G_OPTION_ARG_CALLBACK,
       _print_version_and_exit, N_("Show the application's version"), NULL},
+    { "text-file", 't', 0, G_OPTION_ARG_FILENAME, &text_file,
+      N_("Read the sample text from FILE, or standard input if FILE is -"), N_("FILE") },
     { NULL }
 };
 
-#define WHITESPACE_CHARS "\f \t"
-
-static void
-strip_whitespace (gchar **original)
-{
-    g_auto(GStrv) split = NULL;
-    g_autoptr(GString) reassembled = NULL;
-    const gchar *str;
-    gint idx, n_stripped;
-    size_t len;
-
-    split = g_strsplit (*original, "\n", -1);
-    reassembled = g_string_new (NULL);
-    n_stripped = 0;
-
-    for (idx = 0; split[idx] != NULL; idx++) {
-        str = split[idx];
-
-        len = strspn (str, WHITESPACE_CHARS);
-        if (len)
-            str += len;
-
-        if (strlen (str) == 0 &&
-            ((split[idx + 1] == NULL) || strlen (split[idx + 1]) == 0))
-            continue;
-
-        if (n_stripped++ > 0)
-            g_string_append (reassembled, "\n");
-        g_string_append (reassembled, str);
-    }
-
-    g_free (*original);
-    *original = g_strdup (reassembled->str);
-}
-
-#define MATCH_VERSION_STR "Version"
-
-static void
-strip_version (gchar **original)
-{
-    gchar *ptr, *stripped;
-
-    ptr = g_strstr_len (*original, -1, MATCH_VERSION_STR);
-    if (!ptr)
-        return;
-
-    ptr += strlen (MATCH_VERSION_STR);
-    stripped = g_strdup (ptr);
-
-    strip_whitespace (&stripped);
-
-    g_free (*original);
-    *original = stripped;
-}
-
 static void
 add_row (GtkWidget *grid,
          const gchar *name,
@@ -264,307 +153,27 @@ add_row (GtkWidget *grid,
                              1, 1);
 }
 
-#define FixedToFloat(f) (((float)(f))/65536.0)
-
-static char *
-describe_axis (FT_Var_Axis *ax)
-{
-  return g_strdup_printf (_("%s %g — %g, default %g"), ax->name,
-                          FixedToFloat (ax->minimum),
-                          FixedToFloat (ax->maximum),
-                          FixedToFloat (ax->def));
-}
-
-static char *
-get_sfnt_name (FT_Face face,
-               guint id)
-{
-    guint count, i;
-
-    count = FT_Get_Sfnt_Name_Count (face);
-    for (i = 0; i < count; i++) {
-        FT_SfntName sname;
-
-        if (FT_Get_Sfnt_Name (face, i, &sname) != 0)
-            continue;
-
-        if (sname.name_id != id)
-            continue;
-
-        if (!(sname.platform_id == TT_PLATFORM_MICROSOFT &&
-            sname.encoding_id == TT_MS_ID_UNICODE_CS &&
-            sname.language_id == TT_MS_LANGID_ENGLISH_UNITED_STATES))
-            continue;
-
-        return g_convert ((gchar *)sname.string, sname.string_len,
-                          "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-    }
-    return NULL;
-}
-
-static gboolean
-is_valid_subfamily_id (guint id)
-{
-  return id == 2 || id == 17 || (255 < id && id < 32768);
-}
-
-static void
-describe_instance (FT_Face face,
-                   FT_Var_Named_Style *ns,
-                   int pos,
-                   GString *s)
-{
-    g_autofree char *str = NULL;
-
-    if (is_valid_subfamily_id (ns->strid))
-        str = get_sfnt_name (face, ns->strid);
-
-    if (str == NULL)
-        str = g_strdup_printf (_("Instance %d"), pos);
-
-    if (s->len > 0)
-        g_string_append (s, ", ");
-    g_string_append (s, str);
-}
-
-#include "open-type-layout.h"
-
-static char *
-get_features (FT_Face face)
-{
-    g_autoptr(GString) s = NULL;
-    hb_font_t *hb_font;
-    int i, j, k;
-
-    s = g_string_new ("");
-
-    hb_font = hb_ft_font_create (face, NULL);
-    if (hb_font) {
-        hb_tag_t tables[2] = { HB_OT_TAG_GSUB, HB_OT_TAG_GPOS };
-        hb_face_t *hb_face;
-
-        hb_face = hb_font_get_face (hb_font);
-
-        for (i = 0; i < 2; i++) {
-            hb_tag_t features[80];
-            unsigned int count = G_N_ELEMENTS (features);
-            unsigned int script_index = 0;
-            unsigned int lang_index = HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX;
-
-            hb_ot_layout_language_get_feature_tags (hb_face,
-                                                    tables[i],
-                                                    script_index,
-                                                    lang_index,
-                                                    0,
-                                                    &count,
-                                                    features);
-            for (j = 0; j < count; j++) {
-                for (k = 0; k < G_N_ELEMENTS (open_type_layout_features); k++) {
-                    if (open_type_layout_features[k].tag == features[j]) {
-                        if (s->len > 0)
-                            g_string_append (s, C_("OpenType layout", ", "));
-                        g_string_append (s, g_dpgettext2 (NULL, "OpenType layout", open_type_layout_features[k].name));
-                        break;
-                    }
-                }
-            }
-        }
-    }
-
-    if (s->len > 0)
-        return g_strdup (s->str);
-
-    return NULL;
-}
-
-static void
-populate_grid (FontViewApplication *self,
-               GtkWidget *grid,
-               FT_Face face)
-{
-    g_autoptr (GFileInfo) info = NULL;
-    g_autofree gchar *path = NULL;
-    PS_FontInfoRec ps_info;
-
-    add_row (grid, _("Name"), face->family_name, FALSE);
-
-    path = g_file_get_path (self->font_file);
-    add_row (grid, _("Location"), path, FALSE);
-
-    if (face->style_name)
-        add_row (grid, _("Style"), face->style_name, FALSE);
-
-    info = g_file_query_info (self->font_file,
-                              G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
-                              G_FILE_ATTRIBUTE_STANDARD_SIZE,
-                              G_FILE_QUERY_INFO_NONE,
-                              NULL, NULL);
-
-    if (info != NULL) {
-        g_autofree gchar *s = g_content_type_get_description (g_file_info_get_content_type (info));
-        add_row (grid, _("Type"), s, FALSE);
-    }
-
-    if (FT_IS_SFNT (face)) {
-        gint i, len;
-        g_autofree gchar *version = NULL, *copyright = NULL, *description = NULL;
-        g_autofree gchar *designer = NULL, *manufacturer = NULL, *license = NULL;
-
-        len = FT_Get_Sfnt_Name_Count (face);
-        for (i = 0; i < len; i++) {
-            FT_SfntName sname;
-
-            if (FT_Get_Sfnt_Name (face, i, &sname) != 0)
-                continue;
-
-            if (!(sname.platform_id == TT_PLATFORM_MICROSOFT &&
-                  sname.encoding_id == TT_MS_ID_UNICODE_CS &&
-                  sname.language_id == TT_MS_LANGID_ENGLISH_UNITED_STATES))
-                continue;
-
-            switch (sname.name_id) {
-            case TT_NAME_ID_COPYRIGHT:
-                if (!copyright)
-                    copyright = g_convert ((gchar *)sname.string, sname.string_len,
-                                           "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            case TT_NAME_ID_VERSION_STRING:
-                if (!version)
-                    version = g_convert ((gchar *)sname.string, sname.string_len,
-                                         "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            case TT_NAME_ID_DESCRIPTION:
-                if (!description)
-                    description = g_convert ((gchar *)sname.string, sname.string_len,
-                                             "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            case TT_NAME_ID_MANUFACTURER:
-                if (!manufacturer)
-                    manufacturer = g_convert ((gchar *)sname.string, sname.string_len,
-                                              "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            case TT_NAME_ID_DESIGNER:
-                if (!designer)
-                    designer = g_convert ((gchar *)sname.string, sname.string_len,
-                                          "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            case TT_NAME_ID_LICENSE:
-                if (!license)
-                    license = g_convert ((gchar *)sname.string, sname.string_len,
-                                         "UTF-8", "UTF-16BE", NULL, NULL, NULL);
-                break;
-            default:
-                break;
-            }
-        }
-        if (version) {
-            strip_version (&version);
-            add_row (grid, _("Version"), version, FALSE);
-        }
-        if (copyright) {
-            strip_whitespace (&copyright);
-            add_row (grid, _("Copyright"), copyright, TRUE);
-        }
-        if (description) {
-            strip_whitespace (&description);
-            add_row (grid, _("Description"), description, TRUE);
-        }
-        if (manufacturer) {
-            strip_whitespace (&manufacturer);
-            add_row (grid, _("Manufacturer"), manufacturer, TRUE);
-        }
-        if (designer) {
-            strip_whitespace (&designer);
-            add_row (grid, _("Designer"), designer, TRUE);
-        }
-        if (license) {
-            strip_whitespace (&license);
-            add_row (grid, _("License"), license, TRUE);
-        }
-    } else if (FT_Get_PS_Font_Info (face, &ps_info) == 0) {
-        if (ps_info.version && g_utf8_validate (ps_info.version, -1, NULL)) {
-            g_autofree gchar *compressed = g_strcompress (ps_info.version);
-            strip_version (&compressed);
-            add_row (grid, _("Version"), compressed, FALSE);
-        }
-        if (ps_info.notice && g_utf8_validate (ps_info.notice, -1, NULL)) {
-            g_autofree gchar *compressed = g_strcompress (ps_info.notice);
-            strip_whitespace (&compressed);
-            add_row (grid, _("Copyright"), compressed, TRUE);
-        }
-    }
-}
-
-static void
-populate_details (FontViewApplication *self,
-                  GtkWidget *grid,
-                  FT_Face face)
-{
-    g_autofree gchar *glyph_count = NULL, *features = NULL;
-    FT_MM_Var *ft_mm_var;
-
-    glyph_count = g_strdup_printf ("%ld", face->num_glyphs);
-    add_row (grid, _("Glyph Count"), glyph_count, FALSE);
-
-    add_row (grid, _("Color Glyphs"), FT_HAS_COLOR (face) ? _("yes") : _("no"), FALSE);
-
-    features = get_features (face);
-    if (features)
-        add_row (grid, _("Layout Features"), features, TRUE);
-
-    if (FT_Get_MM_Var (face, &ft_mm_var) == 0) {
-        int i;
-        for (i = 0; i < ft_mm_var->num_axis; i++) {
-            g_autofree gchar *s = describe_axis (&ft_mm_var->axis[i]);
-            add_row (grid, i == 0 ? _("Variation Axes") : "", s, FALSE);
-        }
-        {
-            g_autoptr(GString) str = g_string_new ("");
-            for (i = 0; i < ft_mm_var->num_namedstyles; i++)
-                describe_instance (face, &ft_mm_var->namedstyle[i], i, str);
-
-            add_row (grid, _("Named Styles"), str->str, TRUE);
-        }
-        free (ft_mm_var);
-    }
-}
-
-static void
-font_view_populate_from_model (FontViewApplication *self,
-                               guint position,
-                               guint removed,
-                               guint added)
+static GtkWidget *
+build_info_grid (FontInfo *info)
 {
-    GtkFlowBox *flow_box = GTK_FLOW_BOX (self->flow_box);
-    GListModel *list_model = font_view_model_get_list_model (self->model);
-    gint i;
-
-    while (removed--) {
-        GtkFlowBoxChild *child;
+    GtkWidget *grid;
+    guint idx;
 
-        child = gtk_flow_box_get_child_at_index (flow_box, position);
-        gtk_widget_destroy (GTK_WIDGET (child));
-    }
+    grid = gtk_grid_new ();
+    gtk_orientable_set_orientation (GTK_ORIENTABLE (grid), GTK_ORIENTATION_VERTICAL);
+    g_object_set (grid, "margin", 20, NULL);
+    gtk_grid_set_column_spacing (GTK_GRID (grid), 8);
+    gtk_grid_set_row_spacing (GTK_GRID (grid), 2);
 
-    for (i = 0; i < added; i++) {
-        g_autoptr(FontViewModelItem) item = g_list_model_get_item (list_model, position + i);
-        GtkWidget *widget = font_view_item_new (item);
+    for (idx = 0; idx < font_info_get_n_rows (info); idx++) {
+        const gchar *label, *value;
+        gboolean multiline;
 
-        gtk_flow_box_insert (flow_box, widget, position + i);
+        label = font_info_get_row (info, idx, &value, &multiline);
+        add_row (grid, label, value, multiline);
     }
-}
 
-static void
-font_model_items_changed_cb (GListModel *model,
-                             guint position,
-                             guint removed,
-                             guint added,
-                             gpointer user_data)
-{
-    FontViewApplication *self = user_data;
-
-    if (self->flow_box != NULL)
-        font_view_populate_from_model (self, position, removed, added);
+    return grid;
 }
 
 static void
@@ -605,6 +214,20 @@ font_widget_error_cb (SushiFontWidget *font_widget,
     font_view_show_font_error (self, error);
 }
 
+/* Forgets the Info page of the previous font. */
+static void
+font_view_clear_info (FontViewApplication *self)
+{
+    GtkWidget *child;
+
+    g_cancellable_cancel (self->info_cancellable);
+    g_clear_object (&self->info_cancellable);
+
+    child = gtk_bin_get_child (GTK_BIN (self->swin_info));
+    if (child)
+        gtk_widget_destroy (child);
+}
+
 static void
 font_widget_loaded_cb (SushiFontWidget *font_widget,
                        gpointer user_data)
@@ -617,7 +240,9 @@ font_widget_loaded_cb (SushiFontWidget *font_widget,
         return;
 
     uri = sushi_font_widget_get_uri (font_widget);
+    g_clear_object (&self->font_file);
     self->font_file = g_file_new_for_uri (uri);
+    font_view_clear_info (self);
 
     if (face->family_name) {
         hdy_header_bar_set_title (HDY_HEADER_BAR (self->header), face->family_name);
@@ -630,14 +255,42 @@ font_widget_loaded_cb (SushiFontWidget *font_widget,
 
 }
 
+static void
+font_info_loaded_cb (GObject *source_object,
+                     GAsyncResult *res,
+                     gpointer user_data)
+{
+    FontViewApplication *self = user_data;
+    g_autoptr(FontInfo) info = NULL;
+    g_autoptr(GError) error = NULL;
+
+    info = font_info_load_finish (res, &error);
+    if (info == NULL) {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            return;
+
+        g_clear_object (&self->info_cancellable);
+        g_warning ("Can't read the font details: %s", error->message);
+        return;
+    }
+
+    g_clear_object (&self->info_cancellable);
+
+    gtk_container_add (GTK_CONTAINER (self->swin_info), build_info_grid (info));
+    gtk_widget_show_all (self->swin_info);
+
+    if (self->info_button != NULL &&
+        gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (self->info_button)))
+        gtk_stack_set_visible_child_name (GTK_STACK (self->stack), "info");
+}
+
 static void
 info_button_clicked_cb (GtkButton *button,
                         gpointer user_data)
 {
     FontViewApplication *self = user_data;
-    GtkWidget *grid;
-    GtkWidget *child;
     FT_Face face = sushi_font_widget_get_ft_face (SUSHI_FONT_WIDGET (self->font_widget));
+    gint face_index;
 
     if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (button))) {
         gtk_stack_set_visible_child_name (GTK_STACK (self->stack), "preview");
@@ -647,34 +300,21 @@ info_button_clicked_cb (GtkButton *button,
     if (face == NULL)
         return;
 
-    child = gtk_bin_get_child (GTK_BIN (self->swin_info));
-    if (child)
-        gtk_widget_destroy (child);
-
-    grid = gtk_grid_new ();
-    gtk_orientable_set_orientation (GTK_ORIENTABLE (grid), GTK_ORIENTATION_VERTICAL);
-    g_object_set (grid, "margin", 20, NULL);
-    gtk_grid_set_column_spacing (GTK_GRID (grid), 8);
-    gtk_grid_set_row_spacing (GTK_GRID (grid), 2);
-
-    populate_grid (self, grid, face);
-    populate_details (self, grid, face);
-    gtk_container_add (GTK_CONTAINER (self->swin_info), grid);
+    /* The page is built once per font; toggling only switches to it. */
+    if (gtk_bin_get_child (GTK_BIN (self->swin_info)) != NULL) {
+        gtk_stack_set_visible_child_name (GTK_STACK (self->stack), "info");
+        return;
+    }
 
-    gtk_widget_show_all (self->swin_info);
-    gtk_stack_set_visible_child_name (GTK_STACK (self->stack), "info");
-}
+    /* Still being read; the page shows up once it is. */
+    if (self->info_cancellable != NULL)
+        return;
 
-static gint
-font_view_sort_func (GtkFlowBoxChild *child1,
-                     GtkFlowBoxChild *child2,
-                     gpointer user_data)
-{
-    FontViewModelItem *item1 = FONT_VIEW_ITEM (child1)->item;
-    FontViewModelItem *item2 = FONT_VIEW_ITEM (child2)->item;
+    g_object_get (self->font_widget, "face-index", &face_index, NULL);
 
-    return g_strcmp0 (font_view_model_item_get_collation_key (item1),
-                      font_view_model_item_get_collation_key (item2));
+    self->info_cancellable = g_cancellable_new ();
+    font_info_load_async (self->font_file, face_index, self->info_cancellable,
+                          font_info_loaded_cb, self);
 }
 
 static void
@@ -684,8 +324,6 @@ font_view_ensure_model (FontViewApplication *self)
         return;
 
     self->model = font_view_model_new ();
-    g_signal_connect (font_view_model_get_list_model (self->model), "items-changed",
-                      G_CALLBACK (font_model_items_changed_cb), self);
 }
 
 static void
@@ -730,6 +368,8 @@ font_view_application_do_open (FontViewApplication *self,
         GtkWidget *viewport;
 
         self->font_widget = GTK_WIDGET (sushi_font_widget_new (uri, face_index));
+        sushi_font_widget_set_sample_text (SUSHI_FONT_WIDGET (self->font_widget),
+                                           self->sample_text);
         gtk_container_add (GTK_CONTAINER (self->swin_preview), self->font_widget);
         viewport = gtk_widget_get_parent (self->font_widget);
         gtk_scrollable_set_hscroll_policy (GTK_SCROLLABLE (viewport), GTK_SCROLL_NATURAL);
@@ -750,13 +390,11 @@ font_view_application_do_open (FontViewApplication *self,
 }
 
 static void
-view_child_activated_cb (GtkFlowBox *flow_box,
-                         GtkFlowBoxChild *child,
-                         gpointer user_data)
+view_item_activated_cb (FontViewGrid *grid,
+                        FontViewModelItem *item,
+                        gpointer user_data)
 {
     FontViewApplication *self = user_data;
-    FontViewItem *view_item = FONT_VIEW_ITEM (child);
-    FontViewModelItem *item = view_item->item;
     GFile *font_file;
     gint face_index;
 
@@ -767,6 +405,108 @@ view_child_activated_cb (GtkFlowBox *flow_box,
         font_view_application_do_open (self, font_file, face_index);
 }
 
+/* The sample text never changes once loaded, so its query is built the
+ * first time the overview is filtered by coverage and kept. */
+static const FontCoverageQuery *
+font_view_get_sample_query (FontViewApplication *self)
+{
+    guint idx;
+
+    if (self->sample_query != NULL)
+        return self->sample_query;
+
+    self->sample_query = font_coverage_query_new ();
+    for (idx = 0; idx < sample_text_get_n_lines (self->sample_text); idx++) {
+        gsize length;
+        const gchar *line = sample_text_get_line (self->sample_text, idx, &length);
+
+        font_coverage_query_add_text (self->sample_query, line, length);
+    }
+
+    return self->sample_query;
+}
+
+/* The model positions the search matches, or NULL when nothing narrows
+ * the overview. */
+static GArray *
+font_view_get_search_positions (FontViewApplication *self)
+{
+    const gchar *text = gtk_entry_get_text (GTK_ENTRY (self->search_entry));
+    GArray *positions = NULL;
+
+    if (self->model == NULL ||
+        !gtk_search_bar_get_search_mode (GTK_SEARCH_BAR (self->search_bar)))
+        return NULL;
+
+    if (text[0] != '\0')
+        positions = font_view_model_search (self->model, text);
+
+    if (gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (self->coverage_button))) {
+        GArray *covered = font_view_model_filter_by_coverage (self->model, positions,
+                                                              font_view_get_sample_query (self));
+        g_clear_pointer (&positions, g_array_unref);
+        positions = covered;
+    }
+
+    return positions;
+}
+
+static void
+font_view_apply_search (FontViewApplication *self)
+{
+    g_autoptr(GArray) positions = NULL;
+
+    if (self->grid == NULL)
+        return;
+
+    positions = font_view_get_search_positions (self);
+    font_view_grid_set_filter (FONT_VIEW_GRID (self->grid), positions);
+}
+
+/* Reapplies the search to the changed model, leaving the view where
+ * the user left it. */
+static void
+font_view_refresh_search (FontViewApplication *self)
+{
+    g_autoptr(GArray) positions = NULL;
+
+    if (self->grid == NULL)
+        return;
+
+    positions = font_view_get_search_positions (self);
+    font_view_grid_refresh_filter (FONT_VIEW_GRID (self->grid), positions);
+}
+
+/* Coverage is rebuilt after every load; it only matters to the view
+ * while the overview is filtered by it. */
+static void
+font_view_coverage_changed_cb (FontViewApplication *self)
+{
+    if (!gtk_search_bar_get_search_mode (GTK_SEARCH_BAR (self->search_bar)) ||
+        !gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (self->coverage_button)))
+        return;
+
+    font_view_refresh_search (self);
+}
+
+static void
+search_entry_activate_cb (GtkEntry *entry,
+                          gpointer user_data)
+{
+    FontViewApplication *self = user_data;
+    GListModel *list_model;
+    g_autoptr(GArray) positions = NULL;
+    g_autoptr(FontViewModelItem) item = NULL;
+
+    positions = font_view_get_search_positions (self);
+    if (positions == NULL || positions->len == 0)
+        return;
+
+    list_model = font_view_model_get_list_model (self->model);
+    item = g_list_model_get_item (list_model, g_array_index (positions, guint, 0));
+    view_item_activated_cb (NULL, item, self);
+}
+
 static void
 font_view_application_do_overview (FontViewApplication *self)
 {
@@ -780,26 +520,19 @@ font_view_application_do_overview (FontViewApplication *self)
     hdy_header_bar_set_title (HDY_HEADER_BAR (self->header), "Installed Fonts");
     hdy_header_bar_set_subtitle (HDY_HEADER_BAR (self->header), NULL);
 
-    if (self->flow_box == NULL) {
-        GtkWidget *flow_box;
-
-        self->flow_box = flow_box = gtk_flow_box_new ();
-        g_object_set (flow_box,
-                      "column-spacing", VIEW_COLUMN_SPACING,
-                      "margin", VIEW_MARGIN,
-                      "selection-mode", GTK_SELECTION_NONE,
-                      "vexpand", TRUE,
-                      NULL);
-        gtk_flow_box_set_sort_func (GTK_FLOW_BOX (flow_box),
-                                    font_view_sort_func,
-                                    self, NULL);
-        g_signal_connect (flow_box, "child-activated",
-                          G_CALLBACK (view_child_activated_cb), self);
-        gtk_container_add (GTK_CONTAINER (self->swin_view), flow_box);
-
-        font_view_populate_from_model
-            (self, 0, 0,
-             g_list_model_get_n_items (font_view_model_get_list_model (self->model)));
+    if (self->grid == NULL) {
+        self->grid = font_view_grid_new ();
+        gtk_widget_set_vexpand (self->grid, TRUE);
+        font_view_grid_set_model (FONT_VIEW_GRID (self->grid),
+                                  font_view_model_get_list_model (self->model));
+        g_signal_connect (self->grid, "item-activated",
+                          G_CALLBACK (view_item_activated_cb), self);
+        /* Runs after the grid's own handler, which drops the filter. */
+        g_signal_connect_swapped (font_view_model_get_list_model (self->model), "items-changed",
+                                  G_CALLBACK (font_view_refresh_search), self);
+        g_signal_connect_swapped (self->model, "coverage-changed",
+                                  G_CALLBACK (font_view_coverage_changed_cb), self);
+        gtk_container_add (GTK_CONTAINER (self->swin_view), self->grid);
     }
 
     gtk_widget_show_all (self->main_window);
@@ -819,12 +552,20 @@ font_view_window_key_press_event_cb (GtkWidget *widget,
         return TRUE;
     }
 
+    if (g_strcmp0 (gtk_stack_get_visible_child_name (GTK_STACK (self->stack)), "overview") != 0)
+        return FALSE;
+
     if (event->keyval == GDK_KEY_f &&
         (event->state & GDK_CONTROL_MASK) != 0) {
+        GtkSearchBar *search_bar = GTK_SEARCH_BAR (self->search_bar);
+
+        gtk_search_bar_set_search_mode (search_bar,
+                                        !gtk_search_bar_get_search_mode (search_bar));
         return TRUE;
     }
 
-    return FALSE;
+    /* Typing anywhere in the overview starts a search. */
+    return gtk_search_bar_handle_event (GTK_SEARCH_BAR (self->search_bar), (GdkEvent *) event);
 }
 
 static void
@@ -891,7 +632,7 @@ static void
 ensure_window (FontViewApplication *self)
 {
     g_autoptr(GtkBuilder) builder = NULL;
-    GtkWidget *window, *swin, *box;
+    GtkWidget *window, *swin, *box, *search_box;
 
     if (self->main_window)
         return;
@@ -925,6 +666,29 @@ ensure_window (FontViewApplication *self)
 
     builder = gtk_builder_new ();
 
+    self->search_entry = gtk_search_entry_new ();
+    gtk_entry_set_width_chars (GTK_ENTRY (self->search_entry), 30);
+    g_signal_connect_swapped (self->search_entry, "search-changed",
+                              G_CALLBACK (font_view_apply_search), self);
+    g_signal_connect (self->search_entry, "activate",
+                      G_CALLBACK (search_entry_activate_cb), self);
+
+    self->coverage_button = gtk_check_button_new_with_label (_("Renders the sample text"));
+    g_signal_connect_swapped (self->coverage_button, "toggled",
+                              G_CALLBACK (font_view_apply_search), self);
+
+    search_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 12);
+    gtk_container_add (GTK_CONTAINER (search_box), self->search_entry);
+    gtk_container_add (GTK_CONTAINER (search_box), self->coverage_button);
+
+    self->search_bar = gtk_search_bar_new ();
+    gtk_container_add (GTK_CONTAINER (self->search_bar), search_box);
+    g_signal_connect_swapped (self->search_bar, "notify::search-mode-enabled",
+                              G_CALLBACK (font_view_apply_search), self);
+    gtk_search_bar_connect_entry (GTK_SEARCH_BAR (self->search_bar),
+                                  GTK_ENTRY (self->search_entry));
+    gtk_container_add (GTK_CONTAINER (box), self->search_bar);
+
     self->swin_view = swin = gtk_scrolled_window_new (NULL, NULL);
     gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (swin),
                                     GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
@@ -943,6 +707,24 @@ ensure_window (FontViewApplication *self)
     gtk_widget_show_all (window);
 }
 
+static void
+font_view_load_sample_text (FontViewApplication *self)
+{
+    g_autoptr(GError) error = NULL;
+
+    if (text_file != NULL) {
+        self->sample_text = sample_text_new_from_file (text_file, &error);
+        if (self->sample_text == NULL)
+            g_printerr ("Can't load the sample text: %s\n", error->message);
+    }
+
+    if (self->sample_text == NULL)
+        self->sample_text = sample_text_new_from_user_config ();
+
+    if (self->sample_text == NULL)
+        self->sample_text = sample_text_new_builtin ();
+}
+
 static void
 font_view_application_startup (GApplication *application)
 {
@@ -955,6 +737,8 @@ font_view_application_startup (GApplication *application)
     if (!FcInit ())
         g_critical ("Can't initialize fontconfig library");
 
+    font_view_load_sample_text (self);
+
     g_action_map_add_action_entries (G_ACTION_MAP (self), action_entries,
                                      G_N_ELEMENTS (action_entries), self);
 
@@ -979,10 +763,14 @@ font_view_application_dispose (GObject *obj)
     FontViewApplication *self = FONT_VIEW_APPLICATION (obj);
 
     g_cancellable_cancel (self->cancellable);
+    g_cancellable_cancel (self->info_cancellable);
 
     g_clear_object (&self->cancellable);
+    g_clear_object (&self->info_cancellable);
     g_clear_object (&self->font_file);
     g_clear_object (&self->model);
+    g_clear_pointer (&self->sample_text, sample_text_unref);
+    g_clear_pointer (&self->sample_query, font_coverage_query_free);
 
     G_OBJECT_CLASS (font_view_application_parent_class)->dispose (obj);
 }
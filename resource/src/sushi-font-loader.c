@@ -27,21 +27,380 @@
 
 #include "sushi-font-loader.h"
 
+#include <errno.h>
 #include <stdlib.h>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include FT_MULTIPLE_MASTERS_H
 
 #include <gio/gio.h>
+#include <glib/gstdio.h>
+#include <hb-ft.h>
+#include <hb-ot.h>
+
+#define DEFAULT_FACE_CACHE_MB 64
 
 typedef struct {
   FT_Library library;
   FT_Long face_index;
   GFile *file;
 
-  gchar *face_contents;
-  gsize face_length;
+  GBytes *face_contents;
+
+  /* Key into the face cache, and the cached face if it was found. */
+  gchar *cache_key;
+  SushiFace *cached_face;
 } FontLoadJob;
 
+/* A loaded face with everything needed to shape and render it. The
+ * process keeps the most recently used ones in a cache, bounded by the
+ * total size of their font data, so reopening a font is instant.
+ */
+struct _SushiFace {
+  gint ref_count;
+  gchar *cache_key;
+  gsize cost;
+  GList link;
+
+  FT_Face ft_face;
+  GBytes *contents;
+  hb_face_t *hb_face;
+  hb_font_t *hb_font;
+  GHashTable *shape_plans;
+};
+
+G_LOCK_DEFINE_STATIC (face_cache);
+static GHashTable *face_cache = NULL;
+static GQueue face_cache_lru = G_QUEUE_INIT;
+static gsize face_cache_size = 0;
+
+/* A read-only mapping of a local font file. Faces loaded from the same
+ * file (e.g. the members of a collection) share one mapping, and pages
+ * are only read in as FreeType touches them.
+ */
+typedef struct {
+  gchar *key;
+  GMappedFile *mapped_file;
+  gint ref_count;
+} SharedMapping;
+
+G_LOCK_DEFINE_STATIC (shared_mappings);
+static GHashTable *shared_mappings = NULL;
+
+/* A single FreeType library for the whole process. Faces are only
+ * created and destroyed on the main thread, so it needs no locking.
+ */
+FT_Library
+sushi_get_ft_library (void)
+{
+  static FT_Library library = NULL;
+
+  if (g_once_init_enter (&library)) {
+    FT_Library retval;
+
+    if (FT_Init_FreeType (&retval) != FT_Err_Ok)
+      g_error ("Unable to initialize FreeType");
+
+    g_once_init_leave (&library, retval);
+  }
+
+  return library;
+}
+
+static void
+shared_mapping_unref (gpointer data)
+{
+  SharedMapping *mapping = data;
+
+  G_LOCK (shared_mappings);
+
+  if (--mapping->ref_count > 0) {
+    G_UNLOCK (shared_mappings);
+    return;
+  }
+
+  g_hash_table_remove (shared_mappings, mapping->key);
+
+  G_UNLOCK (shared_mappings);
+
+  g_mapped_file_unref (mapping->mapped_file);
+  g_free (mapping->key);
+  g_slice_free (SharedMapping, mapping);
+}
+
+/* Returns the contents of the local file @path, mapped read-only. The
+ * mapping is keyed by identity and modification time, so a replaced
+ * file is mapped afresh instead of reusing stale pages.
+ */
+static GBytes *
+map_font_file (const gchar *path,
+               GError **error)
+{
+  g_autofree gchar *key = NULL;
+  SharedMapping *mapping;
+  GMappedFile *mapped_file;
+  GStatBuf buf;
+
+  if (g_stat (path, &buf) != 0) {
+    int errsv = errno;
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                 "Unable to read the font face file '%s': %s",
+                 path, g_strerror (errsv));
+    return NULL;
+  }
+
+  key = g_strdup_printf ("%s:%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT ":%" G_GINT64_FORMAT,
+                         path, (guint64) buf.st_dev, (guint64) buf.st_ino,
+                         (gint64) buf.st_mtime);
+
+  G_LOCK (shared_mappings);
+
+  if (shared_mappings == NULL)
+    shared_mappings = g_hash_table_new (g_str_hash, g_str_equal);
+
+  mapping = g_hash_table_lookup (shared_mappings, key);
+  if (mapping != NULL) {
+    mapping->ref_count++;
+    G_UNLOCK (shared_mappings);
+    goto out;
+  }
+
+  G_UNLOCK (shared_mappings);
+
+  mapped_file = g_mapped_file_new (path, FALSE, error);
+  if (mapped_file == NULL)
+    return NULL;
+
+  G_LOCK (shared_mappings);
+
+  /* Another thread may have mapped the file in the meantime. */
+  mapping = g_hash_table_lookup (shared_mappings, key);
+  if (mapping != NULL) {
+    mapping->ref_count++;
+    G_UNLOCK (shared_mappings);
+    g_mapped_file_unref (mapped_file);
+    goto out;
+  }
+
+  mapping = g_slice_new0 (SharedMapping);
+  mapping->key = g_steal_pointer (&key);
+  mapping->mapped_file = mapped_file;
+  mapping->ref_count = 1;
+  g_hash_table_insert (shared_mappings, mapping->key, mapping);
+
+  G_UNLOCK (shared_mappings);
+
+ out:
+  return g_bytes_new_with_free_func (g_mapped_file_get_contents (mapping->mapped_file),
+                                     g_mapped_file_get_length (mapping->mapped_file),
+                                     shared_mapping_unref, mapping);
+}
+
+SushiFace *
+sushi_face_ref (SushiFace *face)
+{
+  g_atomic_int_inc (&face->ref_count);
+
+  return face;
+}
+
+void
+sushi_face_unref (SushiFace *face)
+{
+  if (!g_atomic_int_dec_and_test (&face->ref_count))
+    return;
+
+  g_hash_table_unref (face->shape_plans);
+  hb_font_destroy (face->hb_font);
+  hb_face_destroy (face->hb_face);
+  FT_Done_Face (face->ft_face);
+  g_bytes_unref (face->contents);
+  g_free (face->cache_key);
+
+  g_slice_free (SushiFace, face);
+}
+
+/* hb_font_create() starts at the default instance; copy the blend the
+ * FT_Face was opened with so named instances shape as themselves. */
+static void
+sushi_face_set_var_coords (hb_font_t *hb_font,
+                           FT_Face ft_face)
+{
+  FT_MM_Var *mm_var;
+  FT_Fixed *ft_coords;
+  int *coords;
+  FT_UInt i;
+
+  if (!FT_HAS_MULTIPLE_MASTERS (ft_face) ||
+      FT_Get_MM_Var (ft_face, &mm_var) != 0)
+    return;
+
+  ft_coords = g_new0 (FT_Fixed, mm_var->num_axis);
+  coords = g_new0 (int, mm_var->num_axis);
+
+  /* 16.16 from FreeType, 2.14 for HarfBuzz. */
+  if (FT_Get_Var_Blend_Coordinates (ft_face, mm_var->num_axis, ft_coords) == 0)
+    {
+      for (i = 0; i < mm_var->num_axis; i++)
+        coords[i] = ft_coords[i] >> 2;
+
+      hb_font_set_var_coords_normalized (hb_font, coords, mm_var->num_axis);
+    }
+
+  g_free (coords);
+  g_free (ft_coords);
+  FT_Done_MM_Var (sushi_get_ft_library (), mm_var);
+}
+
+static SushiFace *
+sushi_face_new (FT_Face ft_face,
+                GBytes *contents)
+{
+  SushiFace *face = g_slice_new0 (SushiFace);
+
+  face->ref_count = 1;
+  face->link.data = face;
+  face->ft_face = ft_face;
+  face->contents = contents;
+  face->cost = g_bytes_get_size (contents);
+
+  face->hb_face = hb_ft_face_create_referenced (ft_face);
+  face->hb_font = hb_font_create (face->hb_face);
+  hb_ot_font_set_funcs (face->hb_font);
+  sushi_face_set_var_coords (face->hb_font, ft_face);
+  face->shape_plans = g_hash_table_new_full ((GHashFunc) hb_segment_properties_hash,
+                                             (GEqualFunc) hb_segment_properties_equal,
+                                             g_free, (GDestroyNotify) hb_shape_plan_destroy);
+
+  return face;
+}
+
+FT_Face
+sushi_face_get_ft_face (SushiFace *face)
+{
+  return face->ft_face;
+}
+
+hb_face_t *
+sushi_face_get_hb_face (SushiFace *face)
+{
+  return face->hb_face;
+}
+
+hb_font_t *
+sushi_face_get_hb_font (SushiFace *face)
+{
+  return face->hb_font;
+}
+
+/* Returns the shape plan for text with the given properties,
+ * creating it on first use. */
+hb_shape_plan_t *
+sushi_face_get_shape_plan (SushiFace *face,
+                           const hb_segment_properties_t *props)
+{
+  hb_shape_plan_t *plan;
+
+  plan = g_hash_table_lookup (face->shape_plans, props);
+  if (plan != NULL)
+    return plan;
+
+  plan = hb_shape_plan_create_cached (face->hb_face, props, NULL, 0, NULL);
+  g_hash_table_insert (face->shape_plans, g_memdup (props, sizeof (*props)), plan);
+
+  return plan;
+}
+
+static gsize
+face_cache_get_budget (void)
+{
+  static gsize budget = 0;
+
+  if (g_once_init_enter (&budget)) {
+    const gchar *env = g_getenv ("SHOWMYTEXT_FACE_CACHE_MB");
+    guint64 mb = DEFAULT_FACE_CACHE_MB;
+
+    if (env != NULL)
+      mb = g_ascii_strtoull (env, NULL, 10);
+
+    g_once_init_leave (&budget, MAX (mb, 1) * 1024 * 1024);
+  }
+
+  return budget;
+}
+
+static gchar *
+face_cache_key (GFile *file,
+                FT_Long face_index,
+                GFileInfo *info)
+{
+  g_autofree gchar *uri = g_file_get_uri (file);
+  guint64 mtime;
+
+  mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+
+  return g_strdup_printf ("%s:%ld:%" G_GUINT64_FORMAT, uri, (long) face_index, mtime);
+}
+
+/* May be called from the loading thread. */
+static SushiFace *
+face_cache_lookup (const gchar *key)
+{
+  SushiFace *face = NULL;
+
+  G_LOCK (face_cache);
+
+  if (face_cache != NULL)
+    face = g_hash_table_lookup (face_cache, key);
+
+  if (face != NULL) {
+    g_queue_unlink (&face_cache_lru, &face->link);
+    g_queue_push_head_link (&face_cache_lru, &face->link);
+    sushi_face_ref (face);
+  }
+
+  G_UNLOCK (face_cache);
+
+  return face;
+}
+
+/* Adds @face to the cache and evicts the least recently used faces
+ * beyond the byte budget. Faces still in use elsewhere stay alive
+ * until their last reference goes away.
+ */
+static void
+face_cache_insert (SushiFace *face,
+                   const gchar *key)
+{
+  g_autoptr(GPtrArray) evicted = g_ptr_array_new_with_free_func ((GDestroyNotify) sushi_face_unref);
+  gsize budget = face_cache_get_budget ();
+
+  G_LOCK (face_cache);
+
+  if (face_cache == NULL)
+    face_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+  if (g_hash_table_contains (face_cache, key)) {
+    G_UNLOCK (face_cache);
+    return;
+  }
+
+  face->cache_key = g_strdup (key);
+  g_hash_table_insert (face_cache, face->cache_key, sushi_face_ref (face));
+  g_queue_push_head_link (&face_cache_lru, &face->link);
+  face_cache_size += face->cost;
+
+  while (face_cache_size > budget && face_cache_lru.length > 1) {
+    SushiFace *oldest = g_queue_pop_tail_link (&face_cache_lru)->data;
+
+    g_hash_table_remove (face_cache, oldest->cache_key);
+    face_cache_size -= oldest->cost;
+    g_ptr_array_add (evicted, oldest);
+  }
+
+  G_UNLOCK (face_cache);
+}
+
 static FontLoadJob *
 font_load_job_new (FT_Library library,
                    const gchar *uri,
@@ -62,7 +421,9 @@ static void
 font_load_job_free (FontLoadJob *job)
 {
   g_clear_object (&job->file);
-  g_free (job->face_contents);
+  g_clear_pointer (&job->face_contents, g_bytes_unref);
+  g_clear_pointer (&job->cached_face, sushi_face_unref);
+  g_free (job->cache_key);
 
   g_slice_free (FontLoadJob, job);
 }
@@ -78,15 +439,18 @@ face_data_finalizer (void *object)
 
 static FT_Face
 create_face_from_contents (FontLoadJob *job,
-                           gchar **contents,
+                           GBytes **contents,
                            GError **error)
 {
   FT_Error ft_error;
   FT_Face retval;
+  gconstpointer data;
+  gsize length;
 
+  data = g_bytes_get_data (job->face_contents, &length);
   ft_error = FT_New_Memory_Face (job->library,
-                                 (const FT_Byte *) job->face_contents,
-                                 (FT_Long) job->face_length,
+                                 (const FT_Byte *) data,
+                                 (FT_Long) length,
                                  job->face_index,
                                  &retval);
 
@@ -106,11 +470,26 @@ create_face_from_contents (FontLoadJob *job,
 
 static gboolean
 font_load_job_do_load (FontLoadJob *job,
+                       GCancellable *cancellable,
                        GError **error)
 {
-  return g_file_load_contents (job->file, NULL,
-                               &job->face_contents, &job->face_length,
-                               NULL, error);
+  g_autofree gchar *path = g_file_get_path (job->file);
+  gchar *contents;
+  gsize length;
+
+  if (path != NULL) {
+    job->face_contents = map_font_file (path, error);
+    return job->face_contents != NULL;
+  }
+
+  /* Non-local GIO locations can't be mapped; read them into memory. */
+  if (!g_file_load_contents (job->file, cancellable,
+                             &contents, &length,
+                             NULL, error))
+    return FALSE;
+
+  job->face_contents = g_bytes_new_take (contents, length);
+  return TRUE;
 }
 
 static void
@@ -121,8 +500,29 @@ font_load_job (GTask *task,
 {
   FontLoadJob *job = user_data;
   g_autoptr(GError) error = NULL;
+  g_autoptr(GFileInfo) info = NULL;
+
+  /* A load superseded before it got to run must not touch the disk. */
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  info = g_file_query_info (job->file, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                            G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+
+  if (info != NULL) {
+    job->cache_key = face_cache_key (job->file, job->face_index, info);
+    job->cached_face = face_cache_lookup (job->cache_key);
+
+    if (job->cached_face != NULL) {
+      g_task_return_boolean (task, TRUE);
+      return;
+    }
+  }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
 
-  font_load_job_do_load (job, &error);
+  font_load_job_do_load (job, cancellable, &error);
 
   if (error != NULL)
     g_task_return_error (task, g_steal_pointer (&error));
@@ -134,43 +534,62 @@ FT_Face
 sushi_new_ft_face_from_uri (FT_Library library,
                             const gchar *uri,
                             gint face_index,
-                            gchar **contents,
+                            GBytes **contents,
                             GError **error)
 {
   g_autoptr(FontLoadJob) job = font_load_job_new (library, uri, face_index, NULL, NULL);
-  if (!font_load_job_do_load (job, error))
+  if (!font_load_job_do_load (job, NULL, error))
     return NULL;
 
   return create_face_from_contents (job, contents, error);
 }
 
+/* Loads face @face_index of @uri, or takes it from the face cache if
+ * the file has not changed since it was last loaded. Cancelling
+ * @cancellable stops the load before it reads the file, if it has not
+ * got that far yet.
+ */
 void
-sushi_new_ft_face_from_uri_async (FT_Library library,
-                                  const gchar *uri,
-                                  gint face_index,
-                                  GAsyncReadyCallback callback,
-                                  gpointer user_data)
+sushi_face_new_from_uri_async (const gchar *uri,
+                               gint face_index,
+                               GCancellable *cancellable,
+                               GAsyncReadyCallback callback,
+                               gpointer user_data)
 {
-  FontLoadJob *job = font_load_job_new (library, uri, face_index, callback, user_data);
-  g_autoptr(GTask) task = g_task_new (NULL, NULL, callback, user_data);
+  FontLoadJob *job = font_load_job_new (sushi_get_ft_library (), uri, face_index, callback, user_data);
+  g_autoptr(GTask) task = g_task_new (NULL, cancellable, callback, user_data);
 
   g_task_set_task_data (task, job, (GDestroyNotify) font_load_job_free);
   g_task_run_in_thread (task, font_load_job);
 }
 
-FT_Face
-sushi_new_ft_face_from_uri_finish (GAsyncResult *result,
-                                   gchar **contents,
-                                   GError **error)
+SushiFace *
+sushi_face_new_from_uri_finish (GAsyncResult *result,
+                                GError **error)
 {
   FontLoadJob *job;
+  SushiFace *face;
+  GBytes *contents;
+  FT_Face ft_face;
 
   if (!g_task_propagate_boolean (G_TASK (result), error))
     return NULL;
 
   job = g_task_get_task_data (G_TASK (result));
 
-  return create_face_from_contents (job, contents, error);
+  if (job->cached_face != NULL)
+    return g_steal_pointer (&job->cached_face);
+
+  ft_face = create_face_from_contents (job, &contents, error);
+  if (ft_face == NULL)
+    return NULL;
+
+  face = sushi_face_new (ft_face, contents);
+
+  if (job->cache_key != NULL)
+    face_cache_insert (face, job->cache_key);
+
+  return face;
 }
 
 gchar *
@@ -31,21 +31,36 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include <gio/gio.h>
+#include <hb.h>
+
+typedef struct _SushiFace SushiFace;
+
+FT_Library sushi_get_ft_library (void);
+
+SushiFace *sushi_face_ref (SushiFace *face);
+void sushi_face_unref (SushiFace *face);
+
+FT_Face sushi_face_get_ft_face (SushiFace *face);
+hb_face_t *sushi_face_get_hb_face (SushiFace *face);
+hb_font_t *sushi_face_get_hb_font (SushiFace *face);
+hb_shape_plan_t *sushi_face_get_shape_plan (SushiFace *face,
+                                            const hb_segment_properties_t *props);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SushiFace, sushi_face_unref)
 
 FT_Face sushi_new_ft_face_from_uri (FT_Library library,
                                     const gchar *uri,
                                     gint face_index,
-                                    gchar **contents,
+                                    GBytes **contents,
                                     GError **error);
 
-void sushi_new_ft_face_from_uri_async (FT_Library library,
-                                       const gchar *uri,
-                                       gint face_index,
-                                       GAsyncReadyCallback callback,
-                                       gpointer user_data);
+void sushi_face_new_from_uri_async (const gchar *uri,
+                                    gint face_index,
+                                    GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data);
 
-FT_Face sushi_new_ft_face_from_uri_finish (GAsyncResult *result,
-                                           gchar **contents,
+SushiFace *sushi_face_new_from_uri_finish (GAsyncResult *result,
                                            GError **error);
 
 gchar * sushi_get_font_name (FT_Face face,
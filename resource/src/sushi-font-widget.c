@@ -28,6 +28,7 @@
 
 #include "sushi-font-widget.h"
 #include "sushi-font-loader.h"
+#include "sample-text.h"
 
 #include <hb-glib.h>
 #include <math.h>
@@ -44,28 +45,83 @@ enum {
   NUM_SIGNALS
 };
 
+/* A shaped line. The glyphs are relative to the line origin; its
+ * vertical position comes from the layout.
+ */
+typedef struct {
+  guint index;
+  cairo_glyph_t *glyphs;
+  gint num_glyphs;
+  cairo_text_extents_t extents;
+  GList link;
+} LayoutLine;
+
+/* The layout of the sample text for one face, size, device scale and
+ * text serial; any key change replaces it wholesale.
+ *
+ * Short texts are shaped completely when the layout is built. Long
+ * texts are virtualized: only lines near the viewport are shaped, into
+ * a bounded cache, and unseen lines are assumed to be one line_height
+ * tall. Shaping a line refines its height (by its y_advance, normally
+ * zero) through a Fenwick tree, so line positions stay O(log n).
+ */
+typedef struct {
+  FT_Face face;
+  gint size;
+  gint scale;
+  guint text_serial;
+
+  /* Context the lines are shaped and measured with, and the font at
+   * this layout's size, a child of the face's shared font. */
+  cairo_t *cr;
+  PangoContext *context;
+  hb_font_t *hb_font;
+
+  guint n_lines;
+  gboolean is_virtual;
+  gdouble line_height;
+  gdouble baseline_offset;
+  gfloat *height_deltas;
+  guint32 *measured;
+
+  GHashTable *shaped_lines;
+  GQueue lru;
+  guint max_shaped_lines;
+
+  gdouble width;
+  gdouble advance_width;
+  gboolean size_changed;
+} TextLayout;
+
 struct _SushiFontWidget {
   GtkDrawingArea parent_instance;
 
   gchar *uri;
   gint face_index;
 
-  FT_Library library;
+  /* Shared with other previews of the same font; @face is borrowed
+   * from it. */
+  SushiFace *sushi_face;
   FT_Face face;
-  gchar *face_contents;
   gchar *font_name;
-  const gchar *text_1;
-  const gchar *text_2;
-  const gchar *text_3;
-  const gchar *text_4;
-  const gchar *text_5;
-  const gchar *text_6;
-  const gchar *text_7;
-  const gchar *text_8;
-  const gchar *text_9;
-  const gchar *text_10;
-  const gchar *text_11;
-  const gchar *text_12;
+
+  cairo_font_face_t *cr_face;
+
+  /* Only the most recent load may replace the face; earlier ones are
+   * cancelled and their results dropped. */
+  GCancellable *load_cancellable;
+  guint load_serial;
+
+  SampleText *text;
+  guint text_serial;
+
+  TextLayout *layout;
+  guint resize_idle_id;
+
+  /* Alpha mask of @layout rendered at device scale; recoloured on
+   * paint, so only a new layout or text direction invalidates it. */
+  cairo_surface_t *text_mask;
+  GtkTextDirection mask_dir;
 };
 
 static GParamSpec *properties[NUM_PROPERTIES] = { NULL, };
@@ -76,67 +132,66 @@ G_DEFINE_TYPE (SushiFontWidget, sushi_font_widget, GTK_TYPE_DRAWING_AREA)
 #define SURFACE_SIZE 4
 #define SECTION_SPACING 16
 #define LINE_SPACING 2
+#define MAX_MASK_PIXELS (4096 * 4096)
 
-#include "your-text.c"
+/* Texts longer than this are laid out lazily. */
+#define MAX_EAGER_LINES 1000
+#define INITIAL_VIRTUAL_LINES 64
+#define MAX_SHAPED_LINES 512
 
 static void
-text_to_glyphs (cairo_t *cr,
+text_to_glyphs (SushiFontWidget *self,
+                PangoContext *context,
+                hb_font_t *hb_font,
+                gint scale,
                 const gchar *text,
+                gsize length,
                 cairo_glyph_t **glyphs,
                 int *num_glyphs)
 {
   PangoAttribute *fallback_attr;
   PangoAttrList *attr_list;
-  PangoContext *context;
   GList *items;
-  GList *visual_items;
-  FT_Face ft_face;
-  hb_font_t *hb_font;
+  GList *visual_items, *l;
   gdouble x = 0, y = 0;
   gint i;
-  gdouble x_scale, y_scale;
+  gdouble x_scale = scale, y_scale = scale;
 
   *num_glyphs = 0;
   *glyphs = NULL;
 
-  cairo_scaled_font_t *cr_font = cairo_get_scaled_font (cr);
-  ft_face = cairo_ft_scaled_font_lock_face (cr_font);
-  hb_font = hb_ft_font_create (ft_face, NULL);
-
-  cairo_surface_t *target = cairo_get_target (cr);
-  cairo_surface_get_device_scale (target, &x_scale, &y_scale);
-
-  context = pango_cairo_create_context (cr);
   attr_list = pango_attr_list_new ();
   fallback_attr = pango_attr_fallback_new (FALSE);
   pango_attr_list_insert (attr_list, fallback_attr);
 
   items = pango_itemize_with_base_dir (context, PANGO_DIRECTION_LTR,
-                                       text, 0, strlen (text),
+                                       text, 0, length,
                                        attr_list, NULL);
-  g_object_unref (context);
   pango_attr_list_unref (attr_list);
 
   visual_items = pango_reorder_items (items);
 
-  while (visual_items) {
+  for (l = visual_items; l != NULL; l = l->next) {
     PangoItem *item;
     PangoAnalysis analysis;
     hb_buffer_t *hb_buffer;
+    hb_segment_properties_t props;
     hb_glyph_info_t *hb_glyphs;
     hb_glyph_position_t *hb_positions;
     gint n;
 
-    item = visual_items->data;
+    item = l->data;
     analysis = item->analysis;
 
     hb_buffer = hb_buffer_create ();
-    hb_buffer_add_utf8 (hb_buffer, text, -1, item->offset, item->length);
+    hb_buffer_add_utf8 (hb_buffer, text, length, item->offset, item->length);
     hb_buffer_set_script (hb_buffer, hb_glib_script_to_script (analysis.script));
     hb_buffer_set_language (hb_buffer, hb_language_from_string (pango_language_to_string (analysis.language), -1));
     hb_buffer_set_direction (hb_buffer, analysis.level % 2 ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
 
-    hb_shape (hb_font, hb_buffer, NULL, 0);
+    hb_buffer_get_segment_properties (hb_buffer, &props);
+    hb_shape_plan_execute (sushi_face_get_shape_plan (self->sushi_face, &props),
+                           hb_font, hb_buffer, NULL, 0);
 
     n = hb_buffer_get_length (hb_buffer);
     hb_glyphs = hb_buffer_get_glyph_infos (hb_buffer, NULL);
@@ -155,95 +210,30 @@ text_to_glyphs (cairo_t *cr,
     *num_glyphs += n;
 
     hb_buffer_destroy (hb_buffer);
-
-    visual_items = visual_items->next;
   }
 
-  g_list_free_full (visual_items, (GDestroyNotify) pango_item_free);
+  /* The reordered list shares its items with @items. */
+  g_list_free (visual_items);
   g_list_free_full (items, (GDestroyNotify) pango_item_free);
-
-  hb_font_destroy (hb_font);
-  cairo_ft_scaled_font_unlock_face (cr_font);
 }
 
 static void
-text_extents (cairo_t *cr,
-              const char *text,
-              cairo_text_extents_t *extents)
+layout_line_free (LayoutLine *line)
 {
-  g_autofree cairo_glyph_t *glyphs = NULL;
-  gint num_glyphs;
-
-  text_to_glyphs (cr, text, &glyphs, &num_glyphs);
-  cairo_glyph_extents (cr, glyphs, num_glyphs, extents);
+  g_free (line->glyphs);
+  g_slice_free (LayoutLine, line);
 }
 
-/* adapted from gnome-utils:font-viewer/font-view.c
- *
- * Copyright (C) 2002-2003  James Henstridge <james@daa.com.au>
- * Copyright (C) 2010 Cosimo Cecchi <cosimoc@gnome.org>
- *
- * License: GPLv2+
- */
 static void
-draw_string (SushiFontWidget *self,
-             cairo_t *cr,
-             GtkBorder padding,
-	     const gchar *text,
-	     gint *pos_y)
+text_layout_free (TextLayout *layout)
 {
-  g_autofree cairo_glyph_t *glyphs = NULL;
-  cairo_font_extents_t font_extents;
-  cairo_text_extents_t extents;
-  GtkTextDirection text_dir;
-  gint pos_x;
-  gint num_glyphs;
-  gint i;
-
-  text_dir = gtk_widget_get_direction (GTK_WIDGET (self));
-
-  text_to_glyphs (cr, text, &glyphs, &num_glyphs);
-
-  cairo_font_extents (cr, &font_extents);
-  cairo_glyph_extents (cr, glyphs, num_glyphs, &extents);
-
-  if (pos_y != NULL)
-    *pos_y += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING / 2;
-  if (text_dir == GTK_TEXT_DIR_LTR)
-    pos_x = padding.left;
-  else {
-    pos_x = gtk_widget_get_allocated_width (GTK_WIDGET (self)) -
-      extents.x_advance - padding.right;
-  }
-
-  for (i = 0; i < num_glyphs; i++) {
-    glyphs[i].x += pos_x;
-    glyphs[i].y += *pos_y;
-  }
-
-  cairo_move_to (cr, pos_x, *pos_y);
-  cairo_show_glyphs (cr, glyphs, num_glyphs);
-
-  *pos_y += LINE_SPACING / 2;
-}
-
-static gboolean
-check_font_contain_text (FT_Face face,
-                         const gchar *text)
-{
-  g_autofree gunichar *string = NULL;
-  glong len, idx;
-
-  string = g_utf8_to_ucs4_fast (text, -1, &len);
-  for (idx = 0; idx < len; idx++) {
-    gunichar c = string[idx];
-
-    if (!FT_Get_Char_Index (face, c))
-      return FALSE;
-  }
-
-  return TRUE;
+  g_hash_table_unref (layout->shaped_lines);
+  g_free (layout->height_deltas);
+  g_free (layout->measured);
+  g_object_unref (layout->context);
+  hb_font_destroy (layout->hb_font);
+  cairo_destroy (layout->cr);
+  g_slice_free (TextLayout, layout);
 }
 
 static gchar *
@@ -297,19 +287,6 @@ build_strings_for_face (SushiFontWidget *self)
 {
   select_best_charmap (self);
 
-  self->text_1 = line_1;
-  self->text_2 = line_2;
-  self->text_3 = line_3;
-  self->text_4 = line_4;
-  self->text_5 = line_5;
-  self->text_6 = line_6;
-  self->text_7 = line_7;
-  self->text_8 = line_8;
-  self->text_9 = line_9;
-  self->text_10 = line_10;
-  self->text_11 = line_11;
-  self->text_12 = line_12;
-
   g_free (self->font_name);
   self->font_name = sushi_get_font_name (self->face, FALSE);
 }
@@ -323,150 +300,266 @@ build_sizes_table (FT_Face face, gint *alpha_size)
   return sizes;
 }
 
+/* Fenwick tree over the height corrections of measured lines. */
 static void
-sushi_font_widget_size_request (GtkWidget *drawing_area,
-                                gint *width,
-                                gint *height,
-                                gint *min_height)
+height_deltas_add (TextLayout *layout,
+                   guint index,
+                   gfloat delta)
 {
-  SushiFontWidget *self = SUSHI_FONT_WIDGET (drawing_area);
-  gint pixmap_width, pixmap_height;
-  cairo_text_extents_t extents;
-  cairo_font_extents_t font_extents;
-  cairo_font_face_t *font;
-  g_autofree gint *sizes = NULL;
-  gint alpha_size;
-  cairo_t *cr;
-  cairo_surface_t *surface;
-  FT_Face face = self->face;
-  GtkStyleContext *context;
-  GtkStateFlags state;
-  GtkBorder padding;
+  guint i;
 
-  if (face == NULL) {
-    if (width != NULL)
-      *width = 1;
-    if (height != NULL)
-      *height = 1;
-    if (min_height != NULL)
-      *min_height = 1;
+  for (i = index + 1; i <= layout->n_lines; i += i & -i)
+    layout->height_deltas[i] += delta;
+}
 
-    return;
-  }
+/* Returns the top of line @index, which is also the bottom of the
+ * line before it; @index may be n_lines for the total height.
+ */
+static gdouble
+text_layout_line_top (const TextLayout *layout,
+                      guint index)
+{
+  gdouble delta = 0;
+  guint i;
 
-  if (min_height != NULL)
-    *min_height = -1;
+  for (i = index; i > 0; i -= i & -i)
+    delta += layout->height_deltas[i];
 
-  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
-                                        SURFACE_SIZE, SURFACE_SIZE);
-  cr = cairo_create (surface);
-  context = gtk_widget_get_style_context (drawing_area);
-  state = gtk_style_context_get_state (context);
-  gtk_style_context_get_padding (context, state, &padding);
+  return index * layout->line_height + delta;
+}
 
-  sizes = build_sizes_table (face, &alpha_size);
+static gdouble
+text_layout_get_height (const TextLayout *layout)
+{
+  return text_layout_line_top (layout, layout->n_lines);
+}
 
-  pixmap_width = padding.left + padding.right;
-  pixmap_height = padding.top + padding.bottom;
+/* Returns the index of the first line of @layout whose box ends
+ * below @y, or n_lines if there is none.
+ */
+static guint
+text_layout_find_line (const TextLayout *layout,
+                       gdouble y)
+{
+  guint lo = 0, hi = layout->n_lines;
 
-  font = cairo_ft_font_face_create_for_ft_face (face, 0);
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
 
-  if (check_font_contain_text (face, self->font_name))
-    cairo_set_font_face (cr, font);
-  else
-    cairo_set_font_face (cr, NULL);
+    if (text_layout_line_top (layout, mid + 1) <= y)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
 
-  cairo_set_font_face (cr, font);
-  cairo_set_font_size (cr, alpha_size);
-  cairo_font_extents (cr, &font_extents);
+  return lo;
+}
 
-  if (self->text_1 != NULL) {
-    text_extents (cr, self->text_1, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
+static const LayoutLine *
+text_layout_get_line (SushiFontWidget *self,
+                      TextLayout *layout,
+                      guint index)
+{
+  LayoutLine *line;
+  const gchar *text;
+  gsize length;
+
+  line = g_hash_table_lookup (layout->shaped_lines, GUINT_TO_POINTER (index));
+  if (line != NULL) {
+    g_queue_unlink (&layout->lru, &line->link);
+    g_queue_push_head_link (&layout->lru, &line->link);
+    return line;
   }
 
-  if (self->text_2 != NULL) {
-    text_extents (cr, self->text_2, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
+  if (layout->lru.length >= layout->max_shaped_lines) {
+    LayoutLine *oldest = g_queue_pop_tail_link (&layout->lru)->data;
+    g_hash_table_remove (layout->shaped_lines, GUINT_TO_POINTER (oldest->index));
   }
 
-  if (self->text_3 != NULL) {
-    text_extents (cr, self->text_3, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+  line = g_slice_new0 (LayoutLine);
+  line->index = index;
+  line->link.data = line;
 
-  if (self->text_4 != NULL) {
-    text_extents (cr, self->text_4, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+  text = sample_text_get_line (self->text, index, &length);
+  text_to_glyphs (self, layout->context, layout->hb_font, layout->scale,
+                  text, length, &line->glyphs, &line->num_glyphs);
+  cairo_glyph_extents (layout->cr, line->glyphs, line->num_glyphs, &line->extents);
 
-  if (self->text_5 != NULL) {
-    text_extents (cr, self->text_5, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+  g_hash_table_insert (layout->shaped_lines, GUINT_TO_POINTER (index), line);
+  g_queue_push_head_link (&layout->lru, &line->link);
 
-  if (self->text_6 != NULL) {
-    text_extents (cr, self->text_6, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+  /* Refine the estimates the first time a line is measured. */
+  if ((layout->measured[index / 32] & (1u << (index % 32))) == 0) {
+    layout->measured[index / 32] |= 1u << (index % 32);
 
-  if (self->text_7 != NULL) {
-    text_extents (cr, self->text_7, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+    if (line->extents.y_advance != 0) {
+      height_deltas_add (layout, index, line->extents.y_advance);
+      layout->size_changed = TRUE;
+    }
 
-  if (self->text_8 != NULL) {
-    text_extents (cr, self->text_8, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+    if (line->extents.width > layout->width) {
+      layout->width = line->extents.width;
+      layout->size_changed = TRUE;
+    }
 
-  if (self->text_9 != NULL) {
-    text_extents (cr, self->text_9, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
+    layout->advance_width = MAX (layout->advance_width, line->extents.x_advance);
   }
 
-  if (self->text_10 != NULL) {
-    text_extents (cr, self->text_10, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
-  }
+  return line;
+}
 
-  if (self->text_11 != NULL) {
-    text_extents (cr, self->text_11, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
+static TextLayout *
+text_layout_new (SushiFontWidget *self,
+                 gint size,
+                 gint scale)
+{
+  TextLayout *layout;
+  cairo_font_extents_t font_extents;
+  cairo_surface_t *surface;
+  guint i, n_shaped;
+
+  layout = g_slice_new0 (TextLayout);
+  layout->face = self->face;
+  layout->size = size;
+  layout->scale = scale;
+  layout->text_serial = self->text_serial;
+
+  /* Shape at the device scale we draw with, so glyph positions match. */
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                        SURFACE_SIZE, SURFACE_SIZE);
+  cairo_surface_set_device_scale (surface, scale, scale);
+  layout->cr = cairo_create (surface);
+  cairo_surface_destroy (surface);
+
+  cairo_set_font_face (layout->cr, self->cr_face);
+  cairo_set_font_size (layout->cr, size);
+  cairo_font_extents (layout->cr, &font_extents);
+  layout->context = pango_cairo_create_context (layout->cr);
+
+  /* The face's font is shared with other previews of it, so the size
+   * is set on a child font of our own, in 26.6 device units like the
+   * cairo face. */
+  layout->hb_font = hb_font_create_sub_font (sushi_face_get_hb_font (self->sushi_face));
+  hb_font_set_scale (layout->hb_font, size * scale * 64, size * scale * 64);
+  hb_font_set_ppem (layout->hb_font, size * scale, size * scale);
+
+  layout->n_lines = sample_text_get_n_lines (self->text);
+  layout->is_virtual = layout->n_lines > MAX_EAGER_LINES;
+  layout->line_height = font_extents.ascent + font_extents.descent +
+    (LINE_SPACING / 2) * 2;
+  layout->baseline_offset = font_extents.ascent + font_extents.descent +
+    LINE_SPACING / 2;
+  layout->height_deltas = g_new0 (gfloat, layout->n_lines + 1);
+  layout->measured = g_new0 (guint32, layout->n_lines / 32 + 1);
+
+  layout->shaped_lines = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                NULL, (GDestroyNotify) layout_line_free);
+  g_queue_init (&layout->lru);
+
+  if (layout->is_virtual) {
+    layout->max_shaped_lines = MAX_SHAPED_LINES;
+    n_shaped = INITIAL_VIRTUAL_LINES;
+  } else {
+    layout->max_shaped_lines = MAX (layout->n_lines, 1);
+    n_shaped = layout->n_lines;
   }
 
-  if (self->text_12 != NULL) {
-    text_extents (cr, self->text_12, &extents);
-    pixmap_height += font_extents.ascent + font_extents.descent +
-      extents.y_advance + LINE_SPACING;
-    pixmap_width = MAX (pixmap_width, extents.width + padding.left + padding.right);
+  for (i = 0; i < n_shaped; i++)
+    text_layout_get_line (self, layout, i);
+
+  layout->size_changed = FALSE;
+
+  return layout;
+}
+
+/* Returns the layout for the current face and text, laying it out
+ * again only when the face, size, text or device scale changed.
+ */
+static TextLayout *
+ensure_layout (SushiFontWidget *self)
+{
+  g_autofree gint *sizes = NULL;
+  gint alpha_size, scale;
+  TextLayout *layout = self->layout;
+
+  if (self->face == NULL)
+    return NULL;
+
+  sizes = build_sizes_table (self->face, &alpha_size);
+  scale = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+
+  if (layout != NULL &&
+      layout->face == self->face &&
+      layout->size == alpha_size &&
+      layout->scale == scale &&
+      layout->text_serial == self->text_serial)
+    return layout;
+
+  g_clear_pointer (&self->text_mask, cairo_surface_destroy);
+  g_clear_pointer (&self->layout, text_layout_free);
+  self->layout = text_layout_new (self, alpha_size, scale);
+
+  return self->layout;
+}
+
+static gboolean
+resize_idle_cb (gpointer user_data)
+{
+  SushiFontWidget *self = user_data;
+
+  self->resize_idle_id = 0;
+  gtk_widget_queue_resize (GTK_WIDGET (self));
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Requests a new size once painting has refined a virtual layout. */
+static void
+queue_resize_if_changed (SushiFontWidget *self,
+                         TextLayout *layout)
+{
+  if (!layout->size_changed || self->resize_idle_id != 0)
+    return;
+
+  layout->size_changed = FALSE;
+  self->resize_idle_id = g_idle_add (resize_idle_cb, self);
+}
+
+static void
+sushi_font_widget_size_request (GtkWidget *drawing_area,
+                                gint *width,
+                                gint *height,
+                                gint *min_height)
+{
+  SushiFontWidget *self = SUSHI_FONT_WIDGET (drawing_area);
+  TextLayout *layout;
+  gint pixmap_width, pixmap_height;
+  GtkStyleContext *context;
+  GtkStateFlags state;
+  GtkBorder padding;
+
+  layout = ensure_layout (self);
+
+  if (layout == NULL) {
+    if (width != NULL)
+      *width = 1;
+    if (height != NULL)
+      *height = 1;
+    if (min_height != NULL)
+      *min_height = 1;
+
+    return;
   }
 
-  pixmap_height += padding.bottom + SECTION_SPACING;
+  context = gtk_widget_get_style_context (drawing_area);
+  state = gtk_style_context_get_state (context);
+  gtk_style_context_get_padding (context, state, &padding);
+
+  pixmap_width = ceil (layout->width) + padding.left + padding.right;
+  pixmap_height = padding.top + padding.bottom + ceil (text_layout_get_height (layout)) +
+    padding.bottom + SECTION_SPACING;
 
-  if (min_height != NULL && *min_height == -1)
+  if (min_height != NULL)
     *min_height = pixmap_height;
 
   if (width != NULL)
@@ -474,10 +567,6 @@ sushi_font_widget_size_request (GtkWidget *drawing_area,
 
   if (height != NULL)
     *height = pixmap_height;
-
-  cairo_destroy (cr);
-  cairo_font_face_destroy (font);
-  cairo_surface_destroy (surface);
 }
 
 static void
@@ -506,26 +595,125 @@ sushi_font_widget_get_preferred_height (GtkWidget *drawing_area,
   *natural_height = height;
 }
 
+/* adapted from gnome-utils:font-viewer/font-view.c
+ *
+ * Copyright (C) 2002-2003  James Henstridge <james@daa.com.au>
+ * Copyright (C) 2010 Cosimo Cecchi <cosimoc@gnome.org>
+ *
+ * License: GPLv2+
+ */
+/* Paints the lines of @layout into the box starting at @x, @y and
+ * @width wide, aligned according to @text_dir. Only lines that
+ * intersect the vertical range @min_y to @max_y are painted, and
+ * only those get shaped.
+ */
+static void
+paint_layout_lines (SushiFontWidget *self,
+                    cairo_t *cr,
+                    TextLayout *layout,
+                    GtkTextDirection text_dir,
+                    gdouble x,
+                    gdouble y,
+                    gdouble width,
+                    gdouble min_y,
+                    gdouble max_y)
+{
+  guint i;
+
+  for (i = text_layout_find_line (layout, min_y - y); i < layout->n_lines; i++) {
+    const LayoutLine *line;
+    gdouble pos_x, top;
+
+    top = text_layout_line_top (layout, i);
+    if (y + top > max_y)
+      break;
+
+    line = text_layout_get_line (self, layout, i);
+
+    if (text_dir == GTK_TEXT_DIR_LTR)
+      pos_x = x;
+    else
+      pos_x = x + width - line->extents.x_advance;
+
+    /* The glyphs are relative to the line origin, so translate
+     * instead of offsetting them in place. */
+    cairo_save (cr);
+    cairo_translate (cr, pos_x,
+                     y + top + layout->baseline_offset + line->extents.y_advance);
+    cairo_show_glyphs (cr, line->glyphs, line->num_glyphs);
+    cairo_restore (cr);
+  }
+}
+
+/* Renders @layout once into an A8 mask surface at device scale, with a
+ * margin of one em around the line boxes for overhanging ink. Returns
+ * FALSE if the layout is virtual or the mask would be too large, in
+ * which case the caller paints the glyphs directly.
+ */
+static gboolean
+ensure_text_mask (SushiFontWidget *self,
+                  TextLayout *layout,
+                  GtkTextDirection text_dir)
+{
+  gint margin = layout->size;
+  gint mask_width, mask_height;
+  cairo_t *cr;
+
+  if (self->text_mask != NULL && self->mask_dir == text_dir)
+    return TRUE;
+
+  g_clear_pointer (&self->text_mask, cairo_surface_destroy);
+
+  if (layout->is_virtual)
+    return FALSE;
+
+  mask_width = ceil ((layout->advance_width + 2 * margin) * layout->scale);
+  mask_height = ceil ((text_layout_get_height (layout) + 2 * margin) * layout->scale);
+
+  if ((gint64) mask_width * mask_height > MAX_MASK_PIXELS)
+    return FALSE;
+
+  self->text_mask = cairo_image_surface_create (CAIRO_FORMAT_A8,
+                                                mask_width, mask_height);
+  cairo_surface_set_device_scale (self->text_mask, layout->scale, layout->scale);
+  self->mask_dir = text_dir;
+
+  cr = cairo_create (self->text_mask);
+  cairo_set_font_face (cr, self->cr_face);
+  cairo_set_font_size (cr, layout->size);
+  paint_layout_lines (self, cr, layout, text_dir,
+                      margin, margin, layout->advance_width,
+                      -G_MAXDOUBLE, G_MAXDOUBLE);
+  cairo_destroy (cr);
+
+  return TRUE;
+}
+
 static gboolean
 sushi_font_widget_draw (GtkWidget *drawing_area,
                         cairo_t *cr)
 {
   SushiFontWidget *self = SUSHI_FONT_WIDGET (drawing_area);
-  g_autofree gint *sizes = NULL;
-  gint alpha_size,  pos_y = 0;
-  cairo_font_face_t *font = NULL;
-  FT_Face face = self->face;
+  TextLayout *layout;
   GtkStyleContext *context;
   GdkRGBA color;
   GtkBorder padding;
   GtkStateFlags state;
+  GtkTextDirection text_dir;
+  GdkRectangle clip;
   gint allocated_width, allocated_height;
 
-  if (face == NULL)
+  layout = ensure_layout (self);
+  if (layout == NULL)
+    return FALSE;
+
+  /* In a scrolled viewport only a slice of the widget is exposed. */
+  if (!gdk_cairo_get_clip_rectangle (cr, &clip))
     return FALSE;
 
   context = gtk_widget_get_style_context (drawing_area);
   state = gtk_style_context_get_state (context);
+  text_dir = gtk_widget_get_direction (drawing_area);
 
   allocated_width = gtk_widget_get_allocated_width (drawing_area);
   allocated_height = gtk_widget_get_allocated_height (drawing_area);
@@ -538,129 +726,137 @@ sushi_font_widget_draw (GtkWidget *drawing_area,
 
   gdk_cairo_set_source_rgba (cr, &color);
 
-  sizes = build_sizes_table (face, &alpha_size);
-
-  font = cairo_ft_font_face_create_for_ft_face (face, 0);
+  if (ensure_text_mask (self, layout, text_dir)) {
+    gdouble mask_x;
 
-  if (check_font_contain_text (face, self->font_name))
-    cairo_set_font_face (cr, font);
-  else
-    cairo_set_font_face (cr, NULL);
+    if (text_dir == GTK_TEXT_DIR_LTR)
+      mask_x = padding.left;
+    else
+      mask_x = allocated_width - padding.right - layout->advance_width;
 
-  cairo_set_font_face (cr, font);
-  cairo_set_font_size (cr, alpha_size);
-
-  if (self->text_1 != NULL)
-    draw_string (self, cr, padding, self->text_1, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_2 != NULL)
-    draw_string (self, cr, padding, self->text_2, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_3 != NULL)
-    draw_string (self, cr, padding, self->text_3, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_4 != NULL)
-    draw_string (self, cr, padding, self->text_4, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_5 != NULL)
-    draw_string (self, cr, padding, self->text_5, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_6 != NULL)
-    draw_string (self, cr, padding, self->text_6, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
-
-  if (self->text_7 != NULL)
-    draw_string (self, cr, padding, self->text_7, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+    /* Cairo only composites the part of the mask inside the clip. */
+    cairo_mask_surface (cr, self->text_mask,
+                        mask_x - layout->size, padding.top - layout->size);
+    return FALSE;
+  }
 
-  if (self->text_8 != NULL)
-    draw_string (self, cr, padding, self->text_8, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+  cairo_set_font_face (cr, self->cr_face);
+  cairo_set_font_size (cr, layout->size);
+  paint_layout_lines (self, cr, layout, text_dir,
+                      padding.left, padding.top,
+                      allocated_width - padding.left - padding.right,
+                      clip.y - layout->size,
+                      MIN (clip.y + clip.height, allocated_height) + layout->size);
 
-  if (self->text_9 != NULL)
-    draw_string (self, cr, padding, self->text_9, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+  queue_resize_if_changed (self, layout);
 
-  if (self->text_10 != NULL)
-    draw_string (self, cr, padding, self->text_10, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+  return FALSE;
+}
 
-  if (self->text_11 != NULL)
-    draw_string (self, cr, padding, self->text_11, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+static const cairo_user_data_key_t ft_face_key;
 
-  if (self->text_12 != NULL)
-    draw_string (self, cr, padding, self->text_12, &pos_y);
-  if (pos_y > allocated_height)
-    goto end;
+static void
+clear_face_resources (SushiFontWidget *self)
+{
+  g_clear_pointer (&self->text_mask, cairo_surface_destroy);
+  g_clear_pointer (&self->layout, text_layout_free);
+  g_clear_pointer (&self->cr_face, cairo_font_face_destroy);
+}
 
-  pos_y += SECTION_SPACING;
+static void
+setup_face_resources (SushiFontWidget *self)
+{
+  clear_face_resources (self);
+
+  /* Cairo may keep the font face alive past our reference, so it
+   * holds its own reference on the face and the data backing it. */
+  self->cr_face = cairo_ft_font_face_create_for_ft_face (self->face, 0);
+  cairo_font_face_set_user_data (self->cr_face, &ft_face_key,
+                                 sushi_face_ref (self->sushi_face),
+                                 (cairo_destroy_func_t) sushi_face_unref);
+}
 
- end:
-  cairo_font_face_destroy (font);
+typedef struct {
+  SushiFontWidget *self;
+  guint serial;
+} FaceLoadRequest;
 
-  return FALSE;
+static void
+face_load_request_free (FaceLoadRequest *request)
+{
+  g_object_unref (request->self);
+  g_slice_free (FaceLoadRequest, request);
 }
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (FaceLoadRequest, face_load_request_free)
+
 static void
 font_face_async_ready_cb (GObject *object,
                           GAsyncResult *result,
                           gpointer user_data)
 {
-  SushiFontWidget *self = user_data;
+  g_autoptr(FaceLoadRequest) request = user_data;
+  SushiFontWidget *self = request->self;
+  g_autoptr(SushiFace) face = NULL;
   g_autoptr(GError) error = NULL;
 
-  self->face =
-    sushi_new_ft_face_from_uri_finish (result,
-                                       &self->face_contents,
-                                       &error);
+  face = sushi_face_new_from_uri_finish (result, &error);
+
+  /* A newer load has started since; leave the widget alone. */
+  if (request->serial != self->load_serial ||
+      g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  g_clear_object (&self->load_cancellable);
+  clear_face_resources (self);
+  self->face = NULL;
+  g_clear_pointer (&self->sushi_face, sushi_face_unref);
 
   if (error != NULL) {
+    gtk_widget_queue_resize (GTK_WIDGET (self));
     g_signal_emit (self, signals[ERROR], 0, error);
     g_print ("Can't load the font face: %s\n", error->message);
 
     return;
   }
 
+  self->sushi_face = g_steal_pointer (&face);
+  self->face = sushi_face_get_ft_face (self->sushi_face);
+  setup_face_resources (self);
   build_strings_for_face (self);
 
   gtk_widget_queue_resize (GTK_WIDGET (self));
   g_signal_emit (self, signals[LOADED], 0);
 }
 
+/* Starts loading the current uri and face index. Any load still in
+ * flight is cancelled; the face shown so far stays until the new one
+ * arrives.
+ */
 void
 sushi_font_widget_load (SushiFontWidget *self)
 {
-  sushi_new_ft_face_from_uri_async (self->library,
-                                    self->uri,
-                                    self->face_index,
-                                    font_face_async_ready_cb,
-                                    self);
+  FaceLoadRequest *request;
+
+  g_cancellable_cancel (self->load_cancellable);
+  g_clear_object (&self->load_cancellable);
+  self->load_cancellable = g_cancellable_new ();
+
+  request = g_slice_new (FaceLoadRequest);
+  request->self = g_object_ref (self);
+  request->serial = ++self->load_serial;
+
+  sushi_face_new_from_uri_async (self->uri,
+                                 self->face_index,
+                                 self->load_cancellable,
+                                 font_face_async_ready_cb,
+                                 request);
 }
 
 static void
 sushi_font_widget_init (SushiFontWidget *self)
 {
-  FT_Error err = FT_Init_FreeType (&self->library);
-
-  if (err != FT_Err_Ok)
-    g_error ("Unable to initialize FreeType");
+  self->text = sample_text_new_builtin ();
 
   gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self)),
                                GTK_STYLE_CLASS_VIEW);
@@ -697,6 +893,7 @@ sushi_font_widget_set_property (GObject *object,
 
   switch (prop_id) {
   case PROP_URI:
+    g_free (self->uri);
     self->uri = g_value_dup_string (value);
     break;
   case PROP_FACE_INDEX:
@@ -708,6 +905,17 @@ sushi_font_widget_set_property (GObject *object,
   }
 }
 
+static void
+sushi_font_widget_dispose (GObject *object)
+{
+  SushiFontWidget *self = SUSHI_FONT_WIDGET (object);
+
+  g_cancellable_cancel (self->load_cancellable);
+  g_clear_object (&self->load_cancellable);
+
+  G_OBJECT_CLASS (sushi_font_widget_parent_class)->dispose (object);
+}
+
 static void
 sushi_font_widget_finalize (GObject *object)
 {
@@ -715,18 +923,14 @@ sushi_font_widget_finalize (GObject *object)
 
   g_free (self->uri);
 
-  if (self->face != NULL) {
-    FT_Done_Face (self->face);
-    self->face = NULL;
-  }
+  g_clear_handle_id (&self->resize_idle_id, g_source_remove);
+  clear_face_resources (self);
+  g_clear_pointer (&self->text, sample_text_unref);
 
-  g_free (self->font_name);
-  g_free (self->face_contents);
+  self->face = NULL;
+  g_clear_pointer (&self->sushi_face, sushi_face_unref);
 
-  if (self->library != NULL) {
-    FT_Done_FreeType (self->library);
-    self->library = NULL;
-  }
+  g_free (self->font_name);
 
   G_OBJECT_CLASS (sushi_font_widget_parent_class)->finalize (object);
 }
@@ -747,6 +951,7 @@ sushi_font_widget_class_init (SushiFontWidgetClass *klass)
   GObjectClass *oclass = G_OBJECT_CLASS (klass);
   GtkWidgetClass *wclass = GTK_WIDGET_CLASS (klass);
 
+  oclass->dispose = sushi_font_widget_dispose;
   oclass->finalize = sushi_font_widget_finalize;
   oclass->set_property = sushi_font_widget_set_property;
   oclass->get_property = sushi_font_widget_get_property;
@@ -799,6 +1004,21 @@ sushi_font_widget_get_ft_face (SushiFontWidget *self)
   return self->face;
 }
 
+/* Replaces the text shown by the widget. */
+void
+sushi_font_widget_set_sample_text (SushiFontWidget *self,
+                                   SampleText *text)
+{
+  g_return_if_fail (text != NULL);
+
+  sample_text_ref (text);
+  g_clear_pointer (&self->text, sample_text_unref);
+  self->text = text;
+  self->text_serial++;
+
+  gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
 const gchar *
 sushi_font_widget_get_uri (SushiFontWidget *self)
 {
@@ -33,6 +33,8 @@
 #include <cairo/cairo-ft.h>
 #include <hb-ft.h>
 
+#include "sample-text.h"
+
 G_BEGIN_DECLS
 
 #define SUSHI_TYPE_FONT_WIDGET (sushi_font_widget_get_type ())
@@ -49,6 +51,9 @@ const gchar *sushi_font_widget_get_uri (SushiFontWidget *self);
 
 void sushi_font_widget_load (SushiFontWidget *self);
 
+void sushi_font_widget_set_sample_text (SushiFontWidget *self,
+                                        SampleText *text);
+
 G_END_DECLS
 
 #endif /* __SUSHI_FONT_WIDGET_H__ */
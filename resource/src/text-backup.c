@@ -5,7 +5,7 @@
 /* If you make incorrect changes, try again. Copy file text-backup.c. */
 
 static const gchar line_1[] = "This is the text that will appear in the Show My Text window.";
-static const gchar line_2[] = "It will be displayed line-by-line, without word wrap. Max 12 lines.";
+static const gchar line_2[] = "It will be displayed line-by-line, without word wrap.";
 static const gchar line_3[] = "Prohibited: control characters, backslash, slash adjacent to asterisk.";
 static const gchar line_4[] = "No straight double quotes (they are delimiters). Curly quotes OK.";
 static const gchar line_5[] = "Your text must be encloded utf-8, in Basic Multilingual Plane.";